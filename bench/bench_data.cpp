@@ -0,0 +1,292 @@
+#include "benchmark.hpp"
+#include <combinatorics.hpp>
+#include <csv.hpp>
+#include <dataset.hpp>
+#include <generator.hpp>
+#include <modelfile.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ML::bench
+{
+/**********
+* PRIVATE *
+**********/
+namespace
+{
+// Sum of every element, visiting X[i][j] for i in rows and j in columns, or the other way around
+template <typename Matrix>
+float sum_by_rows_(const Matrix& X)
+{
+    float total = 0;
+    for (auto row: X)
+    {
+        total = std::accumulate(std::begin(row), std::end(row), total);
+    }
+    return total;
+}
+template <typename Matrix>
+float sum_by_columns_(const Matrix& X)
+{
+    float total = 0;
+    for (std::size_t j=0; j<X.shape().second; j++)
+    {
+        auto column = X[][j];
+        total = std::accumulate(std::begin(column), std::end(column), total);
+    }
+    return total;
+}
+
+void array2d_(Registry& registry)
+{
+    constexpr std::size_t ROWS = 4096, COLS = 1024, BYTES = ROWS*COLS*sizeof(float);
+    Params params = {{"rows", ROWS}, {"cols", COLS}};
+    registry.add("Array2D/row_major/by_rows", params, [=](Run& run)
+    {
+        Array2D<float> X = random_matrix(ROWS, COLS);
+        run.measure(ROWS, BYTES, [&] { do_not_optimize(sum_by_rows_(X)); });
+    });
+    registry.add("Array2D/row_major/by_columns", params, [=](Run& run)
+    {
+        Array2D<float> X = random_matrix(ROWS, COLS);
+        run.measure(ROWS, BYTES, [&] { do_not_optimize(sum_by_columns_(X)); });
+    });
+    registry.add("Array2D/column_major/by_rows", params, [=](Run& run)
+    {
+        ColumnMajorArray2D<float> X(random_matrix(ROWS, COLS));
+        run.measure(ROWS, BYTES, [&] { do_not_optimize(sum_by_rows_(X)); });
+    });
+    registry.add("Array2D/column_major/by_columns", params, [=](Run& run)
+    {
+        ColumnMajorArray2D<float> X(random_matrix(ROWS, COLS));
+        run.measure(ROWS, BYTES, [&] { do_not_optimize(sum_by_columns_(X)); });
+    });
+}
+
+// The coroutine generators BasicCombinations replaced, kept as the baseline to compare against. Every combination is a
+// nested generator over the selected elements of iterable.
+namespace coroutine_baseline
+{
+template <std::ranges::random_access_range I>
+coro::generator<coro::generator<unsigned>> combinations(I iterable, unsigned r)
+{
+    size_t n = iterable.size();
+    if (r > n) co_return;
+    std::vector<unsigned> indices(r);
+    std::iota(std::begin(indices), std::end(indices), 0u);
+    auto gen_in = [&iterable, &indices]() -> coro::generator<unsigned> { for (unsigned i: indices) co_yield iterable[i]; };
+    co_yield gen_in();
+    for(;;)
+    {
+        unsigned i;
+        for (i=r-1; i!=(unsigned)-1 and indices[i] == i + n - r; i--) { }
+        if (i==(unsigned)-1) co_return;
+        indices[i] += 1;
+        for (unsigned j=i+1; j<r; j++)
+        {
+            indices[j] = indices[j-1] + 1;
+        }
+        co_yield gen_in();
+    }
+}
+template <std::ranges::random_access_range I>
+coro::generator<coro::generator<unsigned>> combinations_with_replacement(I iterable, unsigned r)
+{
+    size_t n = iterable.size();
+    if (not n and r) co_return;
+    std::vector indices(r, 0u);
+    auto gen_in = [&iterable, &indices]() -> coro::generator<unsigned> { for (unsigned i: indices) co_yield iterable[i]; };
+    co_yield gen_in();
+    for(;;)
+    {
+        unsigned i;
+        for (i=r-1; i!=(unsigned)-1 and indices[i] == n - 1; i--) { }
+        if (i==(unsigned)-1) co_return;
+        std::fill(std::begin(indices)+i, std::end(indices), indices[i] + 1);
+        co_yield gen_in();
+    }
+}
+}// namespace coroutine_baseline
+
+// Visits every index of every combination, rows counting combinations
+template <typename Combinations>
+std::size_t checksum_(Combinations&& combinations)
+{
+    std::size_t total = 0;
+    for (auto&& c: combinations)
+    {
+        for (unsigned i: c)
+        {
+            total += i;
+        }
+    }
+    return total;
+}
+
+template <bool WithReplacement>
+void combinations_(Registry& registry, const char* name)
+{
+    for (auto [n, r]: {std::pair<std::int64_t, std::int64_t>{20, 3}, {30, 4}, {16, 6}})
+    {
+        std::size_t count = BasicCombinations<WithReplacement>(n, r).size();
+        std::size_t bytes = count*r*sizeof(unsigned);
+        Params params = {{"n", n}, {"r", r}};
+        registry.add(std::format("{}/BasicCombinations", name), params, [=](Run& run)
+        {
+            run.measure(count, bytes, [&] { do_not_optimize(checksum_(BasicCombinations<WithReplacement>(n, r))); });
+        });
+        registry.add(std::format("{}/coroutine_baseline", name), params, [=](Run& run)
+        {
+            auto iota = std::views::iota(0u, static_cast<unsigned>(n));
+            run.measure(count, bytes, [&]
+            {
+                if constexpr (WithReplacement)
+                {
+                    do_not_optimize(checksum_(coroutine_baseline::combinations_with_replacement(iota, r)));
+                }
+                else
+                {
+                    do_not_optimize(checksum_(coroutine_baseline::combinations(iota, r)));
+                }
+            });
+        });
+    }
+}
+
+// Drops the file's pages from the OS cache so the next read comes from disk. Best effort: where it is not supported
+// (or the filesystem ignores it) the cold benchmarks measure a warm cache.
+void evict_from_page_cache_(const std::string& path)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+// The same data as a CSV file and as a binary dataset, removed when the benchmark ends
+struct DataFiles
+{
+    std::string csv, dataset;
+    std::size_t csv_bytes, dataset_bytes;
+
+    DataFiles(std::size_t rows, std::size_t cols)
+    {
+        auto dir = std::filesystem::temp_directory_path();
+        csv = (dir/"mlpp_bench.csv").string();
+        dataset = (dir/"mlpp_bench.dataset").string();
+        Array2D<float> X = random_matrix(rows, cols);
+        std::vector<float> y = linear_target(X);
+        {
+            std::ofstream file(csv);
+            std::ostream_iterator<char> out(file);
+            for (std::size_t j=0; j<cols; j++)
+            {
+                std::format_to(out, "x{},", j);
+            }
+            std::format_to(out, "y\n");
+            for (std::size_t i=0; i<rows; i++)
+            {
+                for (float x: X[i])
+                {
+                    std::format_to(out, "{},", x);
+                }
+                std::format_to(out, "{}\n", y[i]);
+            }
+        }
+        write_dataset(dataset, X, std::span<const float>(y));
+        csv_bytes = std::filesystem::file_size(csv);
+        dataset_bytes = std::filesystem::file_size(dataset);
+    }
+    ~DataFiles()
+    {
+        std::filesystem::remove(csv);
+        std::filesystem::remove(dataset);
+    }
+};
+
+// Loading includes reading every value: the dataset is mapped lazily, so it is summed to touch all of its pages
+void loading_(Registry& registry)
+{
+    constexpr std::size_t ROWS = 200000, COLS = 16;
+    for (bool cold: {true, false})
+    {
+        const char* cache = cold? "cold":"warm";
+        for (std::int64_t n_jobs: thread_counts())
+        {
+            registry.add(std::format("read_csv/{}", cache), {{"rows", ROWS}, {"cols", COLS}, {"threads", n_jobs}}, [=](Run& run)
+            {
+                DataFiles files(ROWS, COLS);
+                auto load = [&] { do_not_optimize(read_csv<float>(files.csv, {.n_jobs=static_cast<int>(n_jobs)})); };
+                auto setup = [&] { if (cold) evict_from_page_cache_(files.csv); };
+                run.measure(ROWS, files.csv_bytes, setup, load);
+            });
+        }
+        registry.add(std::format("MappedDataset/{}", cache), {{"rows", ROWS}, {"cols", COLS}}, [=](Run& run)
+        {
+            DataFiles files(ROWS, COLS);
+            auto load = [&]
+            {
+                MappedDataset data(files.dataset);
+                data.prefetch();
+                auto y = data.labels<float>();
+                do_not_optimize(sum_by_rows_(data.X()) + std::accumulate(std::begin(y), std::end(y), 0.f));
+            };
+            auto setup = [&] { if (cold) evict_from_page_cache_(files.dataset); };
+            run.measure(ROWS, files.dataset_bytes, setup, load);
+        });
+    }
+}
+
+// Start-up of a serving process: loading a saved pipeline and answering a first single-sample request
+void model_loading_(Registry& registry)
+{
+    constexpr std::size_t ROWS = 10000, COLS = 16;
+    using Served = Pipeline<ZScoreNormalizer, PolynomialFeatures, LogisticRegression>;
+    for (bool cold: {true, false})
+    {
+        registry.add(std::format("load_model/{}", cold? "cold":"warm"), {{"cols", COLS}, {"degree", 2}, {"classes", 4}}, [=](Run& run)
+        {
+            Array2D<float> X = random_matrix(ROWS, COLS);
+            Served pipe(ZScoreNormalizer(), PolynomialFeatures(2), LogisticRegression({.max_iter=20, .solver=Solver::lbfgs}));
+            pipe.fit(X, class_labels(X, 4));
+            std::string path = (std::filesystem::temp_directory_path()/"mlpp_bench.model").string();
+            save_models(path, pipe);
+            auto load = [&]
+            {
+                Served served = load_model<Served>(path);
+                do_not_optimize(served.predict(X.rows(0, 1)));
+            };
+            auto setup = [&] { if (cold) evict_from_page_cache_(path); };
+            run.measure(1, std::filesystem::file_size(path), setup, load);
+            std::filesystem::remove(path);
+        });
+    }
+}
+}// namespace
+
+/*********
+* PUBLIC *
+*********/
+void register_data_benchmarks(Registry& registry)
+{
+    array2d_(registry);
+    combinations_<false>(registry, "combinations");
+    combinations_<true>(registry, "combinations_with_replacement");
+    loading_(registry);
+    model_loading_(registry);
+}
+}// namespace ML::bench
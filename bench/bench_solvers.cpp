@@ -0,0 +1,177 @@
+#include "benchmark.hpp"
+#include <linearregression.hpp>
+#include <logsticregression.hpp>
+#include <mlcommons.hpp>
+
+namespace ML::bench
+{
+/**********
+* PRIVATE *
+**********/
+namespace
+{
+constexpr std::size_t ROWS = 100000;
+constexpr std::size_t ITERS = 20;
+constexpr StoppingParams FIXED_ITERS = {.criterion=StoppingCriterion::none};
+
+std::size_t bytes_(Array2DView<const float> X)
+{
+    return X.size()*X.shape().second*sizeof(float);
+}
+
+// One gradient descent run of ITERS iterations, so rows/s counts rows read by the gradient
+template <typename GradientFunction>
+void gradient_descent_(Registry& registry, const std::string& group, GradientFunction gradient_function, bool binary_y)
+{
+    for (std::int64_t cols: {8, 64})
+    {
+        for (std::int64_t n_jobs: thread_counts())
+        {
+            registry.add(group, {{"rows", ROWS}, {"cols", cols}, {"threads", n_jobs}}, [=](Run& run)
+            {
+                Array2D<float> X = random_matrix(ROWS, cols);
+                std::vector<float> y = linear_target(X);
+                if (binary_y)
+                {
+                    for (float& y_i: y)
+                    {
+                        y_i = y_i > 1;
+                    }
+                }
+                run.measure(ROWS*ITERS, bytes_(X)*ITERS, [&]
+                {
+                    do_not_optimize(gradient_descent(Array2DView<const float>(X), y, 0.01f, ITERS, gradient_function, n_jobs, FIXED_ITERS));
+                });
+            });
+        }
+    }
+}
+
+// predict_into on a copy of the float benchmark data stored as T, bytes counting the narrower or wider storage
+template <typename T>
+void predict_stored_as_(Registry& registry, const std::string& name)
+{
+    registry.add("LinearRegression::predict_into/" + name, {{"rows", ROWS}, {"cols", 16}}, [](Run& run)
+    {
+        Array2D<float> X = random_matrix(ROWS, 16);
+        std::vector<float> y = linear_target(X);
+        Array2D<T> XT(ROWS, 16);
+        std::vector<T> yT(ROWS);
+        for (std::size_t i=0; i<ROWS; i++)
+        {
+            std::ranges::transform(X[i], std::begin(XT[i]), [](float x) { return static_cast<T>(x); });
+            yT[i] = static_cast<T>(y[i]);
+        }
+        BasicLinearRegression<T> lr({.solver=Solver::normal_equations});
+        lr.fit(XT, yT);
+        std::vector<accumulator_t<T>> y_pred(ROWS);
+        run.measure(ROWS, ROWS*16*sizeof(T), [&]
+        {
+            lr.predict_into(XT, y_pred);
+            do_not_optimize(y_pred);
+        });
+    });
+}
+}// namespace
+
+/*********
+* PUBLIC *
+*********/
+void register_solver_benchmarks(Registry& registry)
+{
+    gradient_descent_(registry, "gradient_descent/linear_cost_gradient", linear_cost_gradient, false);
+    gradient_descent_(registry, "gradient_descent/log_cost_gradient", log_cost_gradient, true);
+
+    //The solvers do different amounts of work per fit, so their throughput is per fit, not per iteration
+    std::pair<const char*, Solver> solvers[] = {{"gradient_descent", Solver::gradient_descent}, {"lbfgs", Solver::lbfgs}, {"normal_equations", Solver::normal_equations}};
+    for (auto [solver_name, solver]: solvers)
+    {
+        for (std::int64_t n_jobs: thread_counts())
+        {
+            registry.add(std::format("LinearRegression::fit/{}", solver_name), {{"rows", ROWS}, {"cols", 16}, {"threads", n_jobs}}, [=](Run& run)
+            {
+                Array2D<float> X = random_matrix(ROWS, 16);
+                std::vector<float> y = linear_target(X);
+                run.measure(ROWS, bytes_(X), [&]
+                {
+                    LinearRegression lr({.learning_rate=0.01, .max_iter=ITERS, .n_jobs=static_cast<int>(n_jobs), .solver=solver, .stopping=FIXED_ITERS});
+                    do_not_optimize(lr.fit(X, y));
+                });
+            });
+        }
+    }
+    registry.add("LinearRegression::predict", {{"rows", ROWS}, {"cols", 16}}, [](Run& run)
+    {
+        Array2D<float> X = random_matrix(ROWS, 16);
+        std::vector<float> y = linear_target(X);
+        LinearRegression lr({.solver=Solver::normal_equations});
+        lr.fit(X, y);
+        run.measure(ROWS, bytes_(X), [&] { do_not_optimize(lr.predict(X)); });
+    });
+    registry.add("LinearRegression::predict_into", {{"rows", ROWS}, {"cols", 16}}, [](Run& run)
+    {
+        Array2D<float> X = random_matrix(ROWS, 16);
+        std::vector<float> y = linear_target(X), y_pred(ROWS);
+        LinearRegression lr({.solver=Solver::normal_equations});
+        lr.fit(X, y);
+        run.measure(ROWS, bytes_(X), [&]
+        {
+            lr.predict_into(X, y_pred);
+            do_not_optimize(y_pred);
+        });
+    });
+    predict_stored_as_<double>(registry, "float64");
+#ifdef MLPP_HAS_FLOAT16
+    predict_stored_as_<float16>(registry, "float16");
+#endif
+
+    std::pair<const char*, MultiClass> multiclasses[] = {{"ovr", MultiClass::ovr}, {"multinomial", MultiClass::multinomial}};
+    for (auto [multiclass_name, multiclass]: multiclasses)
+    {
+        for (std::int64_t n_jobs: thread_counts())
+        {
+            registry.add(std::format("LogisticRegression::fit/{}", multiclass_name), {{"rows", ROWS}, {"cols", 16}, {"classes", 4}, {"threads", n_jobs}}, [=](Run& run)
+            {
+                Array2D<float> X = random_matrix(ROWS, 16);
+                std::vector<int> y = class_labels(X, 4);
+                run.measure(ROWS*ITERS, bytes_(X)*ITERS, [&]
+                {
+                    LogisticRegression lr({.learning_rate=0.1, .max_iter=ITERS, .multiclass=multiclass, .n_jobs=static_cast<int>(n_jobs), .stopping=FIXED_ITERS});
+                    do_not_optimize(lr.fit(X, y));
+                });
+            });
+        }
+    }
+    for (std::int64_t n_classes: {2, 4})
+    {
+        Params params = {{"rows", ROWS}, {"cols", 16}, {"classes", n_classes}};
+        auto fitted = [n_classes]
+        {
+            Array2D<float> X = random_matrix(ROWS, 16);
+            LogisticRegression lr({.learning_rate=0.1, .max_iter=ITERS, .stopping=FIXED_ITERS});
+            lr.fit(X, class_labels(X, n_classes));
+            return std::pair(std::move(X), std::move(lr));
+        };
+        registry.add("LogisticRegression::predict", params, [=](Run& run)
+        {
+            auto [X, lr] = fitted();
+            run.measure(ROWS, bytes_(X), [&] { do_not_optimize(lr.predict(X)); });
+        });
+        registry.add("LogisticRegression::predict_proba", params, [=](Run& run)
+        {
+            auto [X, lr] = fitted();
+            run.measure(ROWS, bytes_(X), [&] { do_not_optimize(lr.predict_proba(X)); });
+        });
+        registry.add("LogisticRegression::predict_proba_into", params, [=](Run& run)
+        {
+            auto [X, lr] = fitted();
+            Array2D<float> proba(n_classes, ROWS);
+            run.measure(ROWS, bytes_(X), [&]
+            {
+                lr.predict_proba_into(X, proba);
+                do_not_optimize(proba);
+            });
+        });
+    }
+}
+}// namespace ML::bench
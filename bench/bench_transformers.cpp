@@ -0,0 +1,99 @@
+#include "benchmark.hpp"
+#include <polynomialfeatures.hpp>
+#include <zscorenormalizer.hpp>
+
+namespace ML::bench
+{
+/**********
+* PRIVATE *
+**********/
+namespace
+{
+constexpr std::size_t ROWS = 200000;
+constexpr std::size_t COLS = 32;
+
+// Fit reads X, transform reads X and writes an array of the same shape
+void zscore_(Registry& registry)
+{
+    std::size_t bytes = ROWS*COLS*sizeof(float);
+    for (std::int64_t n_jobs: thread_counts())
+    {
+        Params params = {{"rows", ROWS}, {"cols", COLS}, {"threads", n_jobs}};
+        registry.add("ZScoreNormalizer::fit/row_major", params, [=](Run& run)
+        {
+            Array2D<float> X = random_matrix(ROWS, COLS);
+            run.measure(ROWS, bytes, [&]
+            {
+                ZScoreNormalizer norm(n_jobs);
+                do_not_optimize(norm.fit(X));
+            });
+        });
+        registry.add("ZScoreNormalizer::fit/column_major", params, [=](Run& run)
+        {
+            ColumnMajorArray2D<float> X(random_matrix(ROWS, COLS));
+            run.measure(ROWS, bytes, [&]
+            {
+                ZScoreNormalizer norm(n_jobs);
+                do_not_optimize(norm.fit(X));
+            });
+        });
+        registry.add("ZScoreNormalizer::transform/row_major", params, [=](Run& run)
+        {
+            Array2D<float> X = random_matrix(ROWS, COLS);
+            ZScoreNormalizer norm(n_jobs);
+            norm.fit(X);
+            run.measure(ROWS, 2*bytes, [&] { do_not_optimize(norm.transform(X)); });
+        });
+        registry.add("ZScoreNormalizer::transform_inplace/row_major", params, [=](Run& run)
+        {
+            Array2D<float> X = random_matrix(ROWS, COLS);
+            ZScoreNormalizer norm(n_jobs);
+            norm.fit(X);
+            //Goes back and forth so values stay bounded however many calls are made
+            run.measure(ROWS, 4*bytes, [&]
+            {
+                norm.transform_inplace(X);
+                norm.inverse_transform(X);
+                do_not_optimize(X);
+            });
+        });
+    }
+}
+
+// Throughput counts the bytes written, which dominate: n_features_out() grows as cols^degree
+void polynomial_(Registry& registry)
+{
+    constexpr std::size_t POLY_ROWS = 20000;
+    for (std::int64_t degree: {2, 3, 4})
+    {
+        for (std::int64_t cols: {4, 16})
+        {
+            if (degree == 4 and cols == 16)
+            {
+                continue; //4845 output columns, too big to be representative
+            }
+            for (std::int64_t n_jobs: thread_counts())
+            {
+                registry.add("PolynomialFeatures::transform", {{"rows", POLY_ROWS}, {"cols", cols}, {"degree", degree}, {"threads", n_jobs}}, [=](Run& run)
+                {
+                    Array2D<float> X = random_matrix(POLY_ROWS, cols);
+                    PolynomialFeatures poly({.degree=static_cast<int>(degree), .n_jobs=static_cast<int>(n_jobs)});
+                    poly.fit(X);
+                    std::size_t bytes = POLY_ROWS*(cols+poly.n_features_out())*sizeof(float);
+                    run.measure(POLY_ROWS, bytes, [&] { do_not_optimize(poly.transform(X)); });
+                });
+            }
+        }
+    }
+}
+}// namespace
+
+/*********
+* PUBLIC *
+*********/
+void register_transformer_benchmarks(Registry& registry)
+{
+    zscore_(registry);
+    polynomial_(registry);
+}
+}// namespace ML::bench
@@ -0,0 +1,155 @@
+#include "benchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <random>
+#include <thread>
+
+namespace ML::bench
+{
+/**********
+* PRIVATE *
+**********/
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double seconds_since_(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now()-start).count();
+}
+}// namespace
+
+/*********
+* PUBLIC *
+*********/
+void Run::measure(std::size_t rows, std::size_t bytes, const std::function<void()>& body)
+{
+    result_ = Measurement{};
+    result_.rows = rows;
+    result_.bytes = bytes;
+    //Warm-up call, which also gives a first estimate of how many calls fill min_time
+    auto start = Clock::now();
+    body();
+    double first = std::max(seconds_since_(start), 1e-9);
+    std::size_t iterations = std::clamp<double>(std::ceil(min_time_/first), 1, 1e9);
+    //Calibrate once more, the first call is usually slower (cold caches, page faults)
+    start = Clock::now();
+    for (std::size_t i=0; i<std::min<std::size_t>(iterations, 10); i++)
+    {
+        body();
+    }
+    double per_call = std::max(seconds_since_(start)/std::min<std::size_t>(iterations, 10), 1e-9);
+    iterations = std::clamp<double>(std::ceil(min_time_/per_call), 1, 1e9);
+
+    result_.iterations = iterations;
+    for (std::size_t r=0; r<repetitions_; r++)
+    {
+        start = Clock::now();
+        for (std::size_t i=0; i<iterations; i++)
+        {
+            body();
+        }
+        result_.seconds.push_back(seconds_since_(start)/iterations);
+    }
+}
+
+void Run::measure(std::size_t rows, std::size_t bytes, const std::function<void()>& setup, const std::function<void()>& body)
+{
+    result_ = Measurement{};
+    result_.rows = rows;
+    result_.bytes = bytes;
+    double total = 0;
+    std::size_t iterations = 0;
+    //Calls are timed one by one, so run them until min_time has been spent inside body (at least 3 of them)
+    std::vector<double> times;
+    while (iterations < 3 or total < min_time_*repetitions_)
+    {
+        setup();
+        auto start = Clock::now();
+        body();
+        times.push_back(seconds_since_(start));
+        total += times.back();
+        iterations++;
+    }
+    //Split the calls into repetitions so every benchmark reports the same statistics
+    std::size_t n_reps = std::min(repetitions_, iterations);
+    result_.iterations = iterations/n_reps;
+    for (std::size_t r=0; r<n_reps; r++)
+    {
+        double sum = 0;
+        for (std::size_t i=r*result_.iterations; i<(r+1)*result_.iterations; i++)
+        {
+            sum += times[i];
+        }
+        result_.seconds.push_back(sum/result_.iterations);
+    }
+}
+
+void Registry::add(const std::string& group, Params params, std::function<void(Run&)> function)
+{
+    std::string name = group;
+    for (const auto& [key, value]: params)
+    {
+        name += std::format("/{}={}", key, value);
+    }
+    benchmarks_.push_back({std::move(name), std::move(params), std::move(function)});
+}
+
+Array2D<float> random_matrix(std::size_t rows, std::size_t cols, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    Array2D<float> X(rows, cols);
+    for (auto row: X)
+    {
+        for (float& x: row)
+        {
+            x = dist(rng);
+        }
+    }
+    return X;
+}
+
+std::vector<float> linear_target(Array2DView<const float> X, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0, 0.1);
+    std::vector<float> y(X.size());
+    for (std::size_t i=0; i<X.size(); i++)
+    {
+        float target = 1;
+        for (std::size_t j=0; j<X.shape().second; j++)
+        {
+            target += (j%2? -1.f:1.f)*(j+1)*X[i][j];
+        }
+        y[i] = target + noise(rng);
+    }
+    return y;
+}
+
+std::vector<int> class_labels(Array2DView<const float> X, int n_classes, unsigned seed)
+{
+    std::vector<float> target = linear_target(X, seed);
+    auto [min, max] = std::ranges::minmax(target);
+    std::vector<int> y(target.size());
+    for (std::size_t i=0; i<y.size(); i++)
+    {
+        y[i] = std::min<int>(n_classes-1, (target[i]-min)/(max-min)*n_classes);
+    }
+    return y;
+}
+
+std::vector<std::int64_t> thread_counts()
+{
+    std::int64_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::int64_t> counts;
+    for (std::int64_t n=1; n<cores; n*=2)
+    {
+        counts.push_back(n);
+    }
+    counts.push_back(cores);
+    return counts;
+}
+}// namespace ML::bench
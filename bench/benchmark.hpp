@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "array2D.hpp"
+
+namespace ML::bench
+{
+// Minimal self-contained benchmark harness. A benchmark is a named function that builds its inputs and then hands the
+// code to time to Run::measure, together with the rows and bytes one call processes so that throughput can be
+// reported. Every parameter combination is registered as its own benchmark, named "group/param=value/...", and the
+// parameters are kept apart so the JSON output can be compared between runs without parsing names.
+
+using Params = std::vector<std::pair<std::string, std::int64_t>>;
+
+struct Measurement
+{
+    std::size_t iterations = 0; //Calls per repetition
+    std::vector<double> seconds; //Time per call of every repetition
+    std::size_t rows = 0, bytes = 0; //Processed by one call
+};
+
+class Run
+{
+public:
+    Run(double min_time, std::size_t repetitions):
+        min_time_(min_time), repetitions_(repetitions)
+    {}
+
+    // Calls body repeatedly, enough times to run for min_time per repetition, and records the time per call
+    void measure(std::size_t rows, std::size_t bytes, const std::function<void()>& body);
+    // Same, running setup before every call without timing it (e.g. to evict a file from the page cache)
+    void measure(std::size_t rows, std::size_t bytes, const std::function<void()>& setup, const std::function<void()>& body);
+
+    const Measurement& result() const { return result_; }
+private:
+    double min_time_;
+    std::size_t repetitions_;
+    Measurement result_;
+};
+
+struct Benchmark
+{
+    std::string name;
+    Params params;
+    std::function<void(Run&)> function;
+};
+
+class Registry
+{
+public:
+    // Registers group/param=value/... for the given parameters
+    void add(const std::string& group, Params params, std::function<void(Run&)> function);
+    const std::vector<Benchmark>& benchmarks() const { return benchmarks_; }
+private:
+    std::vector<Benchmark> benchmarks_;
+};
+
+void register_solver_benchmarks(Registry& registry);
+void register_transformer_benchmarks(Registry& registry);
+void register_data_benchmarks(Registry& registry);
+
+// Keeps the compiler from optimizing away a result that is otherwise unused
+template <typename T>
+void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__) or defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// Reproducible inputs: features uniform in [-1, 1), a linear target with some noise and labels of n_classes classes
+// split along that target
+Array2D<float> random_matrix(std::size_t rows, std::size_t cols, unsigned seed = 0);
+std::vector<float> linear_target(Array2DView<const float> X, unsigned seed = 0);
+std::vector<int> class_labels(Array2DView<const float> X, int n_classes, unsigned seed = 0);
+
+// Thread counts to sweep: 1, 2, 4... up to the number of cores, which is always included
+std::vector<std::int64_t> thread_counts();
+}// namespace ML::bench
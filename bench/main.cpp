@@ -0,0 +1,203 @@
+#include "benchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <thread>
+
+// Runs the benchmarks whose name contains every --filter, printing a table and optionally writing the results as JSON:
+//   MLPP_bench [--filter TEXT]... [--json PATH] [--min-time SECONDS] [--repetitions N] [--list]
+// Build with optimizations (-DCMAKE_BUILD_TYPE=Release), the JSON records whether they were on.
+using namespace ML::bench;
+
+namespace
+{
+struct Options
+{
+    std::vector<std::string> filters;
+    std::string json_path;
+    double min_time = 0.5; //Seconds per repetition
+    std::size_t repetitions = 5;
+    bool list = false;
+};
+
+Options parse_args_(int argc, char* argv[])
+{
+    Options options;
+    auto value = [&](int& i)
+    {
+        if (i+1 >= argc)
+        {
+            throw std::invalid_argument(std::format("{} needs a value", argv[i]));
+        }
+        return std::string(argv[++i]);
+    };
+    for (int i=1; i<argc; i++)
+    {
+        if (std::strcmp(argv[i], "--filter") == 0)
+        {
+            options.filters.push_back(value(i));
+        }
+        else if (std::strcmp(argv[i], "--json") == 0)
+        {
+            options.json_path = value(i);
+        }
+        else if (std::strcmp(argv[i], "--min-time") == 0)
+        {
+            options.min_time = std::stod(value(i));
+        }
+        else if (std::strcmp(argv[i], "--repetitions") == 0)
+        {
+            options.repetitions = std::max(1ul, std::stoul(value(i)));
+        }
+        else if (std::strcmp(argv[i], "--list") == 0)
+        {
+            options.list = true;
+        }
+        else
+        {
+            throw std::invalid_argument(std::format("Unknown argument {}", argv[i]));
+        }
+    }
+    return options;
+}
+
+struct Statistics
+{
+    double median, min, max, stddev;
+};
+Statistics statistics_(std::vector<double> seconds)
+{
+    std::ranges::sort(seconds);
+    std::size_t n = seconds.size();
+    double median = n%2? seconds[n/2]:(seconds[n/2-1]+seconds[n/2])/2;
+    double mean = std::accumulate(std::begin(seconds), std::end(seconds), 0.)/n;
+    double var = 0;
+    for (double s: seconds)
+    {
+        var += (s-mean)*(s-mean);
+    }
+    return {median, seconds.front(), seconds.back(), std::sqrt(var/n)};
+}
+
+std::string json_string_(const std::string& s)
+{
+    std::string out = "\"";
+    for (char c: s)
+    {
+        if (c == '"' or c == '\\')
+        {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+std::string build_type_()
+{
+#if defined(__OPTIMIZE__) and defined(NDEBUG)
+    return "release";
+#elif defined(__OPTIMIZE__)
+    return "optimized with asserts";
+#else
+    return "debug";
+#endif
+}
+
+std::string compiler_()
+{
+#if defined(__clang__)
+    return std::format("clang {}", __clang_version__);
+#elif defined(__GNUC__)
+    return std::format("gcc {}", __VERSION__);
+#elif defined(_MSC_VER)
+    return std::format("msvc {}", _MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+}// namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    try
+    {
+        options = parse_args_(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 2;
+    }
+
+    Registry registry;
+    register_solver_benchmarks(registry);
+    register_transformer_benchmarks(registry);
+    register_data_benchmarks(registry);
+
+    std::vector<const Benchmark*> selected;
+    for (const Benchmark& b: registry.benchmarks())
+    {
+        if (std::ranges::all_of(options.filters, [&](const std::string& f) { return b.name.find(f) != std::string::npos; }))
+        {
+            selected.push_back(&b);
+        }
+    }
+    if (options.list)
+    {
+        for (const Benchmark* b: selected)
+        {
+            std::cout << b->name << '\n';
+        }
+        return 0;
+    }
+
+    std::string json = std::format("{{\n  \"context\": {{\"build\": {}, \"compiler\": {}, \"hardware_concurrency\": {}, "
+        "\"min_time\": {}, \"repetitions\": {}, \"timestamp\": {}}},\n  \"benchmarks\": [",
+        json_string_(build_type_()), json_string_(compiler_()), std::thread::hardware_concurrency(), options.min_time,
+        options.repetitions, std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    std::cout << std::format("{:<90} {:>12} {:>8} {:>14} {:>10}\n", "benchmark", "time/call", "+-%", "rows/s", "GB/s");
+    for (std::size_t k=0; k<selected.size(); k++)
+    {
+        const Benchmark& b = *selected[k];
+        Run run(options.min_time, options.repetitions);
+        b.function(run);
+        const Measurement& m = run.result();
+        Statistics s = statistics_(m.seconds);
+        double rows_per_second = m.rows/s.median, gb_per_second = m.bytes/s.median/1e9;
+        std::cout << std::format("{:<90} {:>10.4g}ms {:>8.1f} {:>14.4g} {:>10.3f}\n", b.name, s.median*1e3, 100*s.stddev/s.median,
+            rows_per_second, gb_per_second) << std::flush;
+
+        std::string params;
+        for (const auto& [key, value]: b.params)
+        {
+            params += std::format("{}{}: {}", params.empty()? "":", ", json_string_(key), value);
+        }
+        json += std::format("{}\n    {{\"name\": {}, \"params\": {{{}}}, \"iterations\": {}, \"repetitions\": {}, "
+            "\"seconds\": {{\"median\": {:.9g}, \"min\": {:.9g}, \"max\": {:.9g}, \"stddev\": {:.9g}}}, "
+            "\"rows\": {}, \"bytes\": {}, \"rows_per_second\": {:.9g}, \"gb_per_second\": {:.9g}}}",
+            k? ",":"", json_string_(b.name), params, m.iterations, m.seconds.size(), s.median, s.min, s.max, s.stddev,
+            m.rows, m.bytes, rows_per_second, gb_per_second);
+    }
+    json += "\n  ]\n}\n";
+
+    if (not options.json_path.empty())
+    {
+        std::ofstream file(options.json_path);
+        file << json;
+        if (not file)
+        {
+            std::cerr << std::format("Could not write {}\n", options.json_path);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -7,13 +7,146 @@
 #include <format>
 #include <cassert>
 #include <span>
+#include <new>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
 namespace ML
 {
+inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// Minimal allocator returning storage aligned to Alignment bytes
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator
+{
+    static_assert(Alignment >= alignof(T) and (Alignment & (Alignment-1)) == 0, "Alignment must be a power of 2");
+    using value_type = T;
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    constexpr AlignedAllocator() = default;
+    template <typename U>
+    constexpr AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(::operator new(n*sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* p, std::size_t)
+    {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    constexpr bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+};
+
+// Allocation policy of Array2D. The buffer is always aligned to Alignment bytes. With PadRows the leading dimension
+// (distance between rows) is rounded up so every row starts on an Alignment boundary as well, the padding is
+// zero-initialized and never visible through rows, columns or iterators. Padding is opt-in, it would multiply the size
+// of narrow datasets by up to 16, and Array2DView does not carry the alignment: the kernels taking views (dot
+// products, gradients, ZScoreNormalizer, PolynomialFeatures) make no alignment assumption. Only scratch matrices
+// allocated padded by a kernel itself, such as the Gram blocks of least_squares and newton, are read as aligned.
+template <std::size_t Alignment = CACHE_LINE_SIZE, bool PadRows = false>
+struct AlignedStorage
+{
+    static constexpr std::size_t alignment = Alignment;
+    static constexpr bool pad_rows = PadRows;
+
+    template <typename T>
+    using allocator = AlignedAllocator<T, Alignment>;
+
+    template <typename T>
+    static constexpr std::size_t leading_dimension(std::size_t cols)
+    {
+        if constexpr (PadRows)
+        {
+            static_assert(Alignment % sizeof(T) == 0);
+            constexpr std::size_t per_line = Alignment/sizeof(T);
+            return (cols+per_line-1)/per_line*per_line;
+        }
+        else
+        {
+            return cols;
+        }
+    }
+};
+//Rows padded to the cache line, meant for small scratch matrices and kernels that want aligned loads on every row
+using PaddedStorage = AlignedStorage<CACHE_LINE_SIZE, true>;
+
+// Memory order of Array2D. Row-major rows (and column-major columns) are contiguous spans, the other direction is a
+// strided view, so pick the layout matching the direction hot loops walk.
+enum class Layout { row_major, column_major };
+
 template <typename T>
+class Array2DView;
+
+template <typename T, typename Storage = AlignedStorage<>, Layout L = Layout::row_major>
 class Array2D
 {
+    // View over n elements separated by stride, used for whichever of rows and columns is not contiguous
+    template <typename P>
+    struct Strided_
+    {
+        using ViewType = decltype(std::ranges::subrange(std::declval<P*>(), std::declval<P*>()) | std::views::stride(std::declval<size_t>()));
+
+        ViewType view_;
+        P* first_;
+        size_t size_, stride_;
+        constexpr Strided_(P* first, size_t n, size_t stride):
+            view_(std::ranges::subrange(first, first + (n? stride*(n-1)+1:0)) | std::views::stride(stride)),
+            first_(first),
+            size_(n),
+            stride_(stride)
+        {}
+
+        constexpr size_t size() const
+        {
+            return size_; //Could also do return view_.size() so we don't have to store size_, but that involves some calculations.
+        }
+
+        constexpr P& operator[](size_t i) const
+        {
+            return first_[i*stride_];
+        }
+
+        constexpr auto begin()
+        {
+            return std::begin(view_);
+        }
+
+        constexpr auto begin() const { return std::cbegin(view_); }
+
+        constexpr auto cbegin() const { return begin(); }
+
+        constexpr auto end() { return std::end(view_); }
+        constexpr auto end() const { return std::cend(view_); }
+
+        constexpr auto cend() const { return end(); }
+    };
+
+    static constexpr bool row_major_ = L == Layout::row_major;
+
+    template <typename P>
+    using RowView_ = std::conditional_t<row_major_, std::span<P>, Strided_<P>>;
     template <typename P>
-    using Row_ = std::span<P, std::dynamic_extent>;
+    using ColumnView_ = std::conditional_t<row_major_, Strided_<P>, std::span<P>>;
+
+    template <typename View, typename P>
+    static constexpr View make_view_(P* first, size_t n, size_t stride)
+    {
+        if constexpr (std::is_same_v<View, std::span<P>>)
+        {
+            return View(first, n);
+        }
+        else
+        {
+            return View(first, n, stride);
+        }
+    }
 
     template <typename P>
     struct Columns_;
@@ -21,52 +154,59 @@ class Array2D
     using ConstColumns = Columns_<const T>;
     using Columns = Columns_<T>;
 public:
-    using ConstColumn = ConstColumns::Column;
-    using Column = Columns::Column;
-    using Vector = std::vector<T>;
-    
+    using value_type = T;
+    using ConstColumn = ColumnView_<const T>;
+    using Column = ColumnView_<T>;
+    using Vector = std::vector<T, typename Storage::template allocator<T>>;
+    static constexpr Layout layout = L;
+    //Guaranteed alignment in bytes of data() and of every contiguous row (row-major) or column (column-major)
+    static constexpr std::size_t alignment = Storage::alignment;
+    static constexpr std::size_t row_alignment = row_major_ and Storage::pad_rows? Storage::alignment:alignof(T);
+    static constexpr std::size_t column_alignment = not row_major_ and Storage::pad_rows? Storage::alignment:alignof(T);
+
 
     template <typename P>
     struct Iterator
     {
         using iterator_category = std::random_access_iterator_tag;
-        using value_type = std::span<P>;
+        using value_type = RowView_<P>;
         using difference_type = std::ptrdiff_t;
-        using pointer = std::span<P>*;
-        using reference = std::span<P>&&;
+        using pointer = value_type*;
+        using reference = value_type&&;
         constexpr Iterator() = default;
-        constexpr Iterator(P* start, size_t cols):
-            start_(start), cols_(cols)
+        //step: distance between consecutive rows, inner: distance between consecutive elements of a row
+        constexpr Iterator(P* start, size_t cols, size_t step, size_t inner):
+            start_(start), cols_(cols), step_(step), inner_(inner)
             {}
         constexpr value_type operator*() const
         {
-            return value_type(start_, start_+cols_);
+            return make_view_<value_type>(start_, cols_, inner_);
         }
         constexpr Iterator& operator++()
         {
-            start_ += cols_;
+            start_ += step_;
             return *this;
         }
         constexpr Iterator operator++(int)
         {
             auto oldthis = *this;
-            start_ += cols_;
+            start_ += step_;
             return oldthis;
         }
         constexpr Iterator& operator--()
         {
-            start_ -= cols_;
+            start_ -= step_;
             return *this;
         }
         constexpr Iterator operator--(int)
         {
             auto oldthis = *this;
-            start_ -= cols_;
+            start_ -= step_;
             return oldthis;
         }
         constexpr Iterator& operator+=(size_t offset)
         {
-            start_ += offset*cols_;
+            start_ += offset*step_;
             return *this;
         }
         constexpr Iterator& operator-=(size_t offset)
@@ -85,69 +225,134 @@ public:
         }
         constexpr std::ptrdiff_t operator-(const Iterator& it) const
         {
-            return start_-it.start_;
+            return (start_-it.start_)/static_cast<std::ptrdiff_t>(step_);
         }
         friend constexpr Iterator operator+(size_t offset, const Iterator& it)
         {
             return it+offset;
         }
 
-        constexpr auto operator<=>(const Iterator& rhs) const = default;
+        constexpr auto operator<=>(const Iterator& rhs) const
+        {
+            return start_ <=> rhs.start_;
+        }
+        constexpr bool operator==(const Iterator& rhs) const
+        {
+            return start_ == rhs.start_;
+        }
 
         constexpr value_type operator->()
         {
-            return std::span<P>(start_, cols_);
+            return **this;
         }
 
         constexpr value_type operator[](size_t offset) const
         {
-            return std::span<P>(start_+offset*cols_, cols_);
+            return *(*this + offset);
         }
     private:
         P* start_=nullptr;
-        size_t cols_=0;
+        size_t cols_=0, step_=0, inner_=0;
     };
     constexpr std::size_t index_from_pos(std::size_t i, std::size_t j) const
     {
-        return i*cols_+j;
+        if constexpr (row_major_)
+        {
+            return i*ld_+j;
+        }
+        else
+        {
+            return j*ld_+i;
+        }
     }
-    std::size_t rows_=0, cols_=0;
+    //Distance between consecutive rows and between consecutive elements of a row
+    constexpr std::size_t row_step_() const { return row_major_? ld_:1; }
+    constexpr std::size_t row_inner_() const { return row_major_? 1:ld_; }
+    constexpr std::size_t n_lines_() const { return row_major_? rows_:cols_; }
+    constexpr std::size_t line_length_() const { return row_major_? cols_:rows_; }
+
+    std::size_t rows_=0, cols_=0, ld_=0;
     Vector v_;
 public:
     using iterator = Iterator<T>;
     using const_iterator = Iterator<const T>;
-    using Row = std::span<T>;
+    using Row = RowView_<T>;
+    using ConstRow = RowView_<const T>;
     constexpr Array2D() = default;
     constexpr Array2D(std::size_t rows, std::size_t cols, const T& value):
-        rows_(rows),
-        cols_(cols),
-        v_(rows_*cols_, value) 
-    {}
+        Array2D(rows, cols)
+    {
+        for (size_t k=0; k<n_lines_(); k++)
+        {
+            std::fill_n(v_.data()+k*ld_, line_length_(), value);
+        }
+    }
 
     constexpr Array2D(std::size_t rows, std::size_t cols):
         rows_(rows),
         cols_(cols),
-        v_(rows_*cols_) 
+        ld_(Storage::template leading_dimension<T>(row_major_? cols:rows)),
+        v_(ld_*(row_major_? rows:cols)) 
     {
         //auto view = std::views::chunk(v_, cols);
     }
 
     constexpr Array2D(std::initializer_list<std::initializer_list<T>> init):
-        rows_(init.size()),
-        cols_(init.begin()->size()),
-        v_(rows_*cols_)
+        Array2D(init.size(), init.begin()->size())
     {
-        for (const auto& [i, d]: init | std::views::join | std::views::enumerate)
+        for (const auto& [i, row]: init | std::views::enumerate)
         {
-            v_[i] = d;
+            std::ranges::copy(row, std::begin((*this)[i]));
         }
     }
 
-    constexpr Array2D(std::vector<T> v, size_t rows, size_t cols):
-        rows_(rows),
-        cols_(cols),
-        v_(std::move(v)) 
-    {}
+    //Row-major data, copied into the aligned (and possibly padded) buffer in this layout
+    constexpr Array2D(const std::vector<T>& v, size_t rows, size_t cols):
+        Array2D(rows, cols)
+    {
+        assert(v.size() == rows*cols);
+        for (size_t i=0; i<rows; i++)
+        {
+            std::copy_n(std::begin(v)+i*cols, cols, std::begin((*this)[i]));
+        }
+    }
+
+    //Conversion between layouts and storage policies. Layout changes are done in square tiles, so both the read and
+    //the write side touch whole cache lines.
+    template <typename Storage2, Layout L2>
+    explicit constexpr Array2D(const Array2D<T, Storage2, L2>& other):
+        Array2D(other.shape().first, other.shape().second)
+    {
+        if constexpr (L2 == L)
+        {
+            for (size_t k=0; k<n_lines_(); k++)
+            {
+                std::copy_n(other.data()+k*other.leading_dimension(), line_length_(), v_.data()+k*ld_);
+            }
+        }
+        else
+        {
+            constexpr size_t TILE = 32;
+            //Lines of other are the cross lines of this
+            size_t n_src = row_major_? cols_:rows_, n_dst = n_lines_();
+            const T* src = other.data();
+            size_t ld_src = other.leading_dimension();
+            for (size_t k0=0; k0<n_src; k0+=TILE)
+            {
+                for (size_t l0=0; l0<n_dst; l0+=TILE)
+                {
+                    size_t k1 = std::min(k0+TILE, n_src), l1 = std::min(l0+TILE, n_dst);
+                    for (size_t l=l0; l<l1; l++)
+                    {
+                        for (size_t k=k0; k<k1; k++)
+                        {
+                            v_[l*ld_+k] = src[k*ld_src+l];
+                        }
+                    }
+                }
+            }
+        }
+    }
 
     constexpr size_t size() const
     {
@@ -159,15 +364,25 @@ public:
         return {rows_, cols_};
     }
 
+    //Distance in elements between the start of two consecutive rows (row-major) or columns (column-major), padding
+    //included
+    constexpr std::size_t leading_dimension() const
+    {
+        return ld_;
+    }
+
+    constexpr T* data() { return v_.data(); }
+    constexpr const T* data() const { return v_.data(); }
+
     constexpr T& at(std::size_t i, std::size_t j)
     {
-        if (i>rows_ or j>cols_) throw std::out_of_range(std::format("Indexes out of bounds: {} and {}", rows_, cols_));
-        return *(this)(i, j);
+        if (i>=rows_ or j>=cols_) throw std::out_of_range(std::format("Indexes out of bounds: {} and {}", rows_, cols_));
+        return (*this)(i, j);
     }
     constexpr const T& at(std::size_t i, std::size_t j) const
     {
-        if (i>rows_ or j>cols_) throw std::out_of_range(std::format("Indexes out of bounds: {} and {}", rows_, cols_));
-        return *(this)(i, j);
+        if (i>=rows_ or j>=cols_) throw std::out_of_range(std::format("Indexes out of bounds: {} and {}", rows_, cols_));
+        return (*this)(i, j);
     }
 
     constexpr T& operator()(std::size_t i, std::size_t j)
@@ -179,93 +394,193 @@ public:
         return v_[index_from_pos(i, j)];
     }
 
-    constexpr auto operator[](std::size_t i)
+    constexpr Row operator[](std::size_t i)
     {
-        return std::span(v_.data()+i*cols_, cols_);
+        return make_view_<Row>(v_.data()+i*row_step_(), cols_, row_inner_());
     }
-    constexpr const auto operator[](std::size_t i) const
+    constexpr const ConstRow operator[](std::size_t i) const
     {
-        return std::span(v_.data()+i*cols_, cols_);
+        return make_view_<ConstRow>(v_.data()+i*row_step_(), cols_, row_inner_());
     }
 
     constexpr auto operator[]()
     {
-        return Columns(cols_, rows_, v_.data());
+        return Columns(cols_, rows_, ld_, v_.data());
     }
     constexpr const auto operator[]() const
     {
-        return ConstColumns(cols_, rows_, v_.data());
+        return ConstColumns(cols_, rows_, ld_, v_.data());
     }
 
     constexpr iterator begin() 
     {
-        return {v_.data(), cols_}; 
+        return {v_.data(), cols_, row_step_(), row_inner_()}; 
     }
-    constexpr const_iterator begin() const { return {v_.data(), cols_}; }
+    constexpr const_iterator begin() const { return {v_.data(), cols_, row_step_(), row_inner_()}; }
 
     constexpr const_iterator cbegin() const { return begin(); }
 
-    constexpr iterator end() { return {v_.data()+cols_*rows_, cols_}; }
-    constexpr const_iterator end() const { return {v_.data()+cols_*rows_, cols_}; }
+    constexpr iterator end() { return {v_.data()+row_step_()*rows_, cols_, row_step_(), row_inner_()}; }
+    constexpr const_iterator end() const { return {v_.data()+row_step_()*rows_, cols_, row_step_(), row_inner_()}; }
 
     constexpr const_iterator cend() const { return end(); }
 
+    //Non-owning views over the rows [first, last), or the columns [first, last), of a row-major array
+    constexpr Array2DView<T> rows(std::size_t first, std::size_t last) requires row_major_;
+    constexpr Array2DView<const T> rows(std::size_t first, std::size_t last) const requires row_major_;
+    constexpr Array2DView<T> cols(std::size_t first, std::size_t last) requires row_major_;
+    constexpr Array2DView<const T> cols(std::size_t first, std::size_t last) const requires row_major_;
 };
 
-template <typename T>
+template <typename T, typename Storage, Layout L>
 template <typename P>
-struct Array2D<T>::Columns_
+struct Array2D<T, Storage, L>::Columns_
 {
-    struct Column
+    constexpr ColumnView_<P> operator[](size_t i) const
     {
-        using ViewType = decltype(std::ranges::subrange(std::declval<P*>(), std::declval<P*>()) | std::views::stride(std::declval<size_t>()));
-
-        ViewType column_;
-        size_t size_;
-        constexpr Column(P* begin, P* end, size_t cols, size_t rows):
-            column_(std::ranges::subrange(begin, end) | std::views::stride(cols)),
-            size_(rows)
-        {}
-
-        constexpr size_t size() const
+        assert(i < cols_);
+        if constexpr (row_major_)
         {
-            return size_; //Could also do return column_.size() so we don't have to store size_, but that involves some calculations.
+            return make_view_<ColumnView_<P>>(begin+i, rows_, ld_);
         }
-
-        constexpr auto begin()
+        else
         {
-            return std::begin(column_);
+            return make_view_<ColumnView_<P>>(begin+i*ld_, rows_, 1);
         }
+    }
+    size_t cols_, rows_, ld_;
+    P* begin;
+};
 
-        constexpr auto begin() const { return std::cbegin(column_); }
+template <typename T>
+using ColumnMajorArray2D = Array2D<T, AlignedStorage<>, Layout::column_major>;
 
-        constexpr auto cbegin() const { return begin(); }
+// Non-owning row-major view of rows*cols elements, consecutive rows being stride elements apart. It wraps row-major
+// Array2Ds (const T for read-only views), row/column slices of them and external buffers such as mapped files, and is
+// what estimators and transformers take, so slicing never copies the data. The viewed memory must outlive the view.
+// Rows of a view have no alignment guarantee beyond alignof(T).
+template <typename T>
+class Array2DView
+{
+    using Owner_ = Array2D<std::remove_const_t<T>>;
+public:
+    using value_type = std::remove_const_t<T>;
+    static constexpr Layout layout = Layout::row_major;
+    using Row = std::span<T>;
+    using Column = std::conditional_t<std::is_const_v<T>, typename Owner_::ConstColumn, typename Owner_::Column>;
+    using iterator = typename Owner_::template Iterator<T>;
+    using const_iterator = iterator;
 
-        constexpr auto end() { return std::end(column_); }
-        constexpr auto end() const { return std::cend(column_); }
+    constexpr Array2DView() = default;
+    constexpr Array2DView(T* data, std::size_t rows, std::size_t cols, std::size_t stride):
+        data_(data), rows_(rows), cols_(cols), stride_(stride)
+    {
+        assert(stride >= cols);
+    }
+    //Dense buffer, rows one after the other
+    constexpr Array2DView(T* data, std::size_t rows, std::size_t cols):
+        Array2DView(data, rows, cols, cols)
+    {}
 
-        constexpr auto cend() const { return end(); }
-    };
-    constexpr Column operator[](size_t i)
+    template <typename Storage>
+    constexpr Array2DView(Array2D<value_type, Storage>& a):
+        Array2DView(a.data(), a.shape().first, a.shape().second, a.leading_dimension())
+    {}
+    template <typename Storage>
+    constexpr Array2DView(const Array2D<value_type, Storage>& a) requires std::is_const_v<T>:
+        Array2DView(a.data(), a.shape().first, a.shape().second, a.leading_dimension())
+    {}
+    //Mutable to read-only
+    template <typename U>
+    requires (std::is_const_v<T> and std::is_same_v<U, value_type>)
+    constexpr Array2DView(const Array2DView<U>& v):
+        Array2DView(v.data(), v.shape().first, v.shape().second, v.leading_dimension())
+    {}
+
+    constexpr std::size_t size() const
     {
-        auto start = begin+i;
-        auto end = start + cols_*(rows_-1)+1;
-        assert(start < end and end <= begin+rows_*cols_);
-        return Column(start, start + cols_*(rows_-1)+1, cols_, rows_);
+        return rows_;
     }
-    constexpr Column operator[](size_t i) const
+
+    constexpr std::pair<std::size_t, std::size_t> shape() const
     {
-        auto start = begin+i;
-        auto end = start + cols_*(rows_-1)+1;
-        assert(start < end and end <= begin+rows_*cols_);
-        return Column(start, start + cols_*(rows_-1)+1, cols_, rows_);
+        return {rows_, cols_};
     }
-    size_t cols_, rows_;
-    P* begin;
+
+    constexpr std::size_t leading_dimension() const
+    {
+        return stride_;
+    }
+
+    constexpr T* data() const { return data_; }
+
+    constexpr T& operator()(std::size_t i, std::size_t j) const
+    {
+        return data_[i*stride_+j];
+    }
+
+    constexpr Row operator[](std::size_t i) const
+    {
+        return Row(data_+i*stride_, cols_);
+    }
+
+    constexpr auto operator[]() const
+    {
+        struct Columns
+        {
+            constexpr Column operator[](std::size_t j) const
+            {
+                assert(j < cols_);
+                return Column(begin+j, rows_, stride_);
+            }
+            std::size_t cols_, rows_, stride_;
+            T* begin;
+        };
+        return Columns{cols_, rows_, stride_, data_};
+    }
+
+    constexpr iterator begin() const { return {data_, cols_, stride_, 1}; }
+    constexpr iterator end() const { return {data_+rows_*stride_, cols_, stride_, 1}; }
+
+    constexpr Array2DView rows(std::size_t first, std::size_t last) const
+    {
+        assert(first <= last and last <= rows_);
+        return Array2DView(data_+first*stride_, last-first, cols_, stride_);
+    }
+    constexpr Array2DView cols(std::size_t first, std::size_t last) const
+    {
+        assert(first <= last and last <= cols_);
+        return Array2DView(data_+first, rows_, last-first, stride_);
+    }
+private:
+    T* data_ = nullptr;
+    std::size_t rows_ = 0, cols_ = 0, stride_ = 0;
 };
 
-template <typename T>
-std::ostream& operator<<(std::ostream& os, const Array2D<T>& a)
+template <typename T, typename Storage, Layout L>
+constexpr Array2DView<T> Array2D<T, Storage, L>::rows(std::size_t first, std::size_t last) requires row_major_
+{
+    return Array2DView<T>(*this).rows(first, last);
+}
+template <typename T, typename Storage, Layout L>
+constexpr Array2DView<const T> Array2D<T, Storage, L>::rows(std::size_t first, std::size_t last) const requires row_major_
+{
+    return Array2DView<const T>(*this).rows(first, last);
+}
+template <typename T, typename Storage, Layout L>
+constexpr Array2DView<T> Array2D<T, Storage, L>::cols(std::size_t first, std::size_t last) requires row_major_
+{
+    return Array2DView<T>(*this).cols(first, last);
+}
+template <typename T, typename Storage, Layout L>
+constexpr Array2DView<const T> Array2D<T, Storage, L>::cols(std::size_t first, std::size_t last) const requires row_major_
+{
+    return Array2DView<const T>(*this).cols(first, last);
+}
+
+template <typename Matrix>
+requires requires(const Matrix& a) { a(0, 0); a.shape(); }
+std::ostream& operator<<(std::ostream& os, const Matrix& a)
 {
     for (std::size_t i=0; i<a.shape().first; i++)
     {
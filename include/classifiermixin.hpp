@@ -11,10 +11,16 @@ public:
     constexpr static EstimatorType estimator_type = EstimatorType::classifier;
     constexpr static bool requires_y = true;
     
-    float score(const Array2D<float>& X, const std::vector<int>& y)
+    //X is anything predict takes, an Array2DView or a PolynomialExpansion. Predictions are counted as they are made
+    //instead of being collected.
+    float score(const SampleMatrix auto& X, const std::vector<int>& y) const
     {
-        std::vector<int> y_pred = this->underlying().predict(X);
-        return accuracy_score(y, y_pred);
+        size_t correct_preds = 0;
+        detail::for_each_prediction_(this->underlying(), X, [&](size_t i, int y_pred)
+        {
+            correct_preds += y[i] == y_pred;
+        });
+        return correct_preds/static_cast<float>(X.size());
     }
 };
 
@@ -0,0 +1,228 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace ML
+{
+// C(n, k), 0 when k > n. Multiplicative formula, every partial product is itself a binomial coefficient so the
+// divisions are exact.
+constexpr auto binomial_coefficient(std::integral auto n, std::integral auto k)
+{
+    using type = std::common_type_t<decltype(n), decltype(k)>;
+    if (std::cmp_less(k, 0) or std::cmp_greater(k, n))
+    {
+        return type{0};
+    }
+    type k_ = std::min<type>(k, n-k);
+    type result = 1;
+    for (type i=1; i<=k_; i++)
+    {
+        result = result*(n-k_+i)/i;
+    }
+    return result;
+}
+
+inline constexpr unsigned MAX_COMBINATION_SIZE = 16;
+
+// The indices of a combination in a fixed capacity buffer, so that neither combinations nor the iterators that produce
+// them touch the heap. A contiguous range, so it converts to std::span<const unsigned>.
+class Combination
+{
+public:
+    constexpr Combination() = default;
+    constexpr explicit Combination(unsigned size):
+        size_(size)
+    {}
+
+    constexpr std::size_t size() const { return size_; }
+    constexpr unsigned* data() { return indices_.data(); }
+    constexpr const unsigned* data() const { return indices_.data(); }
+    constexpr unsigned* begin() { return data(); }
+    constexpr unsigned* end() { return data()+size_; }
+    constexpr const unsigned* begin() const { return data(); }
+    constexpr const unsigned* end() const { return data()+size_; }
+    constexpr unsigned& operator[](std::size_t i) { return indices_[i]; }
+    constexpr unsigned operator[](std::size_t i) const { return indices_[i]; }
+
+    constexpr bool operator==(const Combination& other) const
+    {
+        return std::ranges::equal(*this, other);
+    }
+private:
+    std::array<unsigned, MAX_COMBINATION_SIZE> indices_{};
+    unsigned size_ = 0;
+};
+
+// The r-combinations of {0, ..., n-1} in lexicographic order (the order of Python's itertools), with repeated indices
+// when WithReplacement is set, for r up to MAX_COMBINATION_SIZE. An iterator holds the current Combination, which ++
+// updates in place, so walking or copying never allocates. *it refers into the iterator and is only valid until the
+// iterator is incremented or destroyed, which makes it an input iterator: copy the Combination to keep it. Every
+// combination has a rank, its position in the sequence: rank and unrank convert between both and slice(first, last)
+// starts iterating at any rank, which is how the sequence is split across threads. Everything is constexpr.
+template <bool WithReplacement>
+class BasicCombinations
+{
+public:
+    class iterator
+    {
+    public:
+        using value_type = Combination;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::input_iterator_tag;
+
+        constexpr iterator() = default;
+
+        constexpr const Combination& operator*() const
+        {
+            return indices_;
+        }
+        constexpr iterator& operator++()
+        {
+            next_();
+            rank_++;
+            return *this;
+        }
+        //No copy of the previous position, its combination would not outlive the expression
+        constexpr void operator++(int)
+        {
+            ++*this;
+        }
+        //Only ranks are compared, so the end of a slice needs no indices
+        constexpr bool operator==(const iterator& other) const
+        {
+            return rank_ == other.rank_;
+        }
+
+        // Position of *it in the whole sequence
+        constexpr std::size_t rank() const
+        {
+            return rank_;
+        }
+    private:
+        friend BasicCombinations;
+        constexpr iterator(unsigned n, std::size_t rank, const Combination& indices):
+            n_(n), rank_(rank), indices_(indices)
+        {}
+
+        constexpr void next_()
+        {
+            unsigned r = indices_.size();
+            unsigned i = r;
+            //Rightmost index that can still grow
+            while (i-- > 0)
+            {
+                if (indices_[i] != (WithReplacement? n_-1:i+n_-r))
+                {
+                    break;
+                }
+            }
+            if (i == static_cast<unsigned>(-1))
+            {
+                return; //Was the last one
+            }
+            indices_[i]++;
+            for (unsigned j=i+1; j<r; j++)
+            {
+                indices_[j] = WithReplacement? indices_[i]:indices_[j-1]+1;
+            }
+        }
+
+        unsigned n_ = 0;
+        std::size_t rank_ = 0;
+        Combination indices_;
+    };
+
+    // Throws std::invalid_argument if r is above MAX_COMBINATION_SIZE
+    constexpr BasicCombinations(unsigned n, unsigned r):
+        n_(n), r_(r)
+    {
+        if (r > MAX_COMBINATION_SIZE)
+        {
+            throw std::invalid_argument("Combinations of more than MAX_COMBINATION_SIZE indices are not supported");
+        }
+        if constexpr (WithReplacement)
+        {
+            size_ = n == 0? r == 0:binomial_coefficient(std::size_t{n}+r-1, std::size_t{r});
+        }
+        else
+        {
+            size_ = binomial_coefficient(std::size_t{n}, std::size_t{r});
+        }
+    }
+
+    constexpr std::size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+
+    constexpr iterator begin() const { return at(0); }
+    constexpr iterator end() const { return iterator(n_, size_, {}); }
+
+    // Iterator to the combination of rank k (end() from size() on)
+    constexpr iterator at(std::size_t k) const
+    {
+        if (k >= size_)
+        {
+            return end();
+        }
+        Combination indices(r_);
+        unrank(k, indices);
+        return iterator(n_, k, indices);
+    }
+    // Combinations of ranks [first, last)
+    constexpr std::ranges::subrange<iterator> slice(std::size_t first, std::size_t last) const
+    {
+        return {at(first), iterator(n_, std::min(last, size_), {})};
+    }
+
+    constexpr std::size_t rank(std::span<const unsigned> c) const
+    {
+        //With replacement, c[i]+i is a combination without replacement of {0, ..., n+r-2} in the same order
+        std::size_t m = WithReplacement? n_+r_-1:n_;
+        std::size_t result = 0, first = 0;
+        for (unsigned i=0; i<r_; i++)
+        {
+            std::size_t c_i = c[i] + (WithReplacement? i:0);
+            //Same prefix, smaller index at position i: the sum of C(m-1-x, r-1-i) for x in [first, c_i)
+            result += binomial_coefficient(m-first, std::size_t{r_-i}) - binomial_coefficient(m-c_i, std::size_t{r_-i});
+            first = c_i+1;
+        }
+        return result;
+    }
+    constexpr void unrank(std::size_t k, std::span<unsigned> c) const
+    {
+        std::size_t m = WithReplacement? n_+r_-1:n_;
+        std::size_t x = 0;
+        for (unsigned i=0; i<r_; i++, x++)
+        {
+            for (std::size_t count; (count = binomial_coefficient(m-1-x, std::size_t{r_-1-i})) <= k; x++)
+            {
+                k -= count;
+            }
+            c[i] = x - (WithReplacement? i:0);
+        }
+    }
+private:
+    unsigned n_, r_;
+    std::size_t size_;
+};
+
+using Combinations = BasicCombinations<false>;
+using CombinationsWithReplacement = BasicCombinations<true>;
+
+// for (const Combination& c: combinations(4, 2)) visits {0, 1}, {0, 2}, ..., {2, 3}
+constexpr Combinations combinations(unsigned n, unsigned r)
+{
+    return Combinations(n, r);
+}
+constexpr CombinationsWithReplacement combinations_with_replacement(unsigned n, unsigned r)
+{
+    return CombinationsWithReplacement(n, r);
+}
+}// namespace ML
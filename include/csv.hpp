@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "array2D.hpp"
+
+namespace ML
+{
+//Used as read_csv("data.csv", {.label_column=0, .n_jobs=-1});
+struct CSVParams
+{
+    static constexpr int LAST_COLUMN = -1;
+    static constexpr int NO_LABEL = -2;
+
+    char delimiter = ',';
+    bool header = true; //First line holds column names, otherwise it is data
+    int label_column = LAST_COLUMN; //Index of the label column, LAST_COLUMN or NO_LABEL
+    int n_jobs = 1; //Threads used to parse, -1 for all cores
+};
+
+template <typename Label>
+struct CSVData
+{
+    Array2D<float> X;
+    std::vector<Label> y; //Empty with CSVParams::NO_LABEL
+    std::vector<size_t> malformed_lines; //1-based line numbers of the rows that could not be parsed and were skipped
+};
+
+// Reads a numeric CSV file into a feature matrix and a label vector. The file is memory-mapped and split into
+// newline-aligned chunks: a first parallel pass counts the rows of every chunk so X is allocated once, and a second one
+// parses every chunk with std::from_chars straight into its rows. Blank lines are ignored and '\r\n' line endings are
+// accepted. Rows with a wrong number of cells or a cell that is not a number (quoted fields are not supported) are
+// left out and reported in malformed_lines. Throws std::runtime_error if the file can not be read.
+template <typename Label = int>
+CSVData<Label> read_csv(const std::string& path, const CSVParams& params = {});
+
+extern template CSVData<int> read_csv<int>(const std::string&, const CSVParams&);
+extern template CSVData<float> read_csv<float>(const std::string&, const CSVParams&);
+}// namespace ML
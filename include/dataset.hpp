@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <variant>
+#include <stdexcept>
+#include <type_traits>
+#include "array2D.hpp"
+#include "mappedfile.hpp"
+
+namespace ML
+{
+// Binary dataset files: a 64-byte header followed by the features and then the (optional) labels, both starting on a
+// 64-byte boundary and stored densely (no row padding) in native byte order. Loading one is just mapping it, the
+// matrix is used in place and pages are read from disk the first time they are touched.
+
+enum class DType : std::uint32_t { none = 0, float32 = 1, int32 = 2, float64 = 3, int64 = 4, uint32 = 5, float16 = 6 };
+
+struct DatasetHeader
+{
+    static constexpr char MAGIC[8] = {'M', 'L', 'P', 'P', 'D', 'S', 'E', 'T'};
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::uint32_t ENDIAN_TAG = 0x01020304; //Reads differently on a machine with the other byte order
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t endian_tag;
+    std::uint64_t rows;
+    std::uint64_t cols;
+    DType dtype;
+    Layout layout;
+    DType label_dtype;
+    std::uint32_t reserved;
+    std::uint64_t data_offset;
+    std::uint64_t label_offset;
+};
+static_assert(sizeof(DatasetHeader) == DatasetHeader::ALIGNMENT and std::is_trivially_copyable_v<DatasetHeader>);
+static_assert(sizeof(int) == 4 and sizeof(float) == 4);
+
+using DatasetLabels = std::variant<std::monostate, std::span<const float>, std::span<const int>>;
+
+// Writes X (and y, if given) to path, replacing the file. Throws std::runtime_error on I/O errors.
+void write_dataset(const std::string& path, Array2DView<const float> X, DatasetLabels y = {});
+void write_dataset(const std::string& path, const ColumnMajorArray2D<float>& X, DatasetLabels y = {});
+
+// Read-only memory mapping of a file written by write_dataset. The views it hands out point into the mapping, so they
+// are only valid while the MappedDataset is alive.
+class MappedDataset
+{
+public:
+    // Throws std::runtime_error if the file can not be mapped or is not a valid dataset for this machine
+    explicit MappedDataset(const std::string& path);
+
+    std::size_t size() const { return header_->rows; }
+    std::pair<std::size_t, std::size_t> shape() const { return {header_->rows, header_->cols}; }
+    Layout layout() const { return header_->layout; }
+    DType label_dtype() const { return header_->label_dtype; }
+
+    // Features of a row-major file
+    Array2DView<const float> X() const;
+    // Feature j of a column-major file, std::out_of_range if there is no such feature
+    std::span<const float> column(std::size_t j) const;
+
+    template <typename Label>
+    std::span<const Label> labels() const
+    {
+        static_assert(std::is_same_v<Label, float> or std::is_same_v<Label, int>, "Labels are either float or int");
+        constexpr DType dtype = std::is_same_v<Label, float>? DType::float32:DType::int32;
+        if (header_->label_dtype != dtype)
+        {
+            throw std::logic_error("Requested label type does not match the one stored in the dataset");
+        }
+        return {reinterpret_cast<const Label*>(file_.bytes().data()+header_->label_offset), size()};
+    }
+
+    // Asks the OS to start reading the whole file in the background, for when all of it is going to be used anyway
+    void prefetch() const { file_.prefetch(); }
+private:
+    MappedFile file_;
+    const DatasetHeader* header_ = nullptr; //Points into file_, which moves along with it
+};
+}// namespace ML
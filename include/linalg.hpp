@@ -0,0 +1,37 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "array2D.hpp"
+#include "scalar.hpp"
+
+namespace ML
+{
+// Small dense solvers for the (n_features+1)x(n_features+1) systems built by the closed-form estimators.
+// Both take A by value and overwrite it with their factorization.
+
+// Solves A*x = b for a symmetric positive definite A through its Cholesky factorization. Only the upper triangle of A
+// is read. Returns false, leaving b untouched, when a pivot falls below rtol times the largest diagonal entry: A is
+// singular, or too ill-conditioned for the accuracy the caller needs.
+bool cholesky_solve(Array2D<double> A, std::vector<double>& b, double rtol = 1e-12);
+
+// Least-squares solution of A*x = b through a column-pivoted Householder QR. Columns whose pivot falls below
+// rcond*|R(0,0)| are treated as linearly dependent and get a zero coefficient, so rank-deficient systems still
+// produce a (basic) solution.
+void qr_solve(Array2D<double> A, std::vector<double>& b, double rcond = 1e-10);
+
+// Solves A*x = b for a symmetric positive semi-definite A given by its upper triangle: Cholesky when A is positive
+// definite, qr_solve on the symmetrized matrix otherwise. The fallback only handles (near) rank deficiency: when A is a
+// Gram matrix its condition number is already that of the data squared, and QR on A does not give it back. Least
+// squares problems with the design matrix at hand should fall back to qr_solve on it instead, see least_squares.
+void symmetric_solve(Array2D<double> A, std::vector<double>& b);
+
+// Outputs of a linear model, Z = X*W^T + b, for K = Z.shape().second outputs whose n_features weights are stored one
+// output after the other in W: the GEMV kernel of batched inference. Every dot product is accumulated in eight
+// independent partial sums of type Acc, which vectorizes where a plain sequential sum can not. Single-threaded, callers
+// split the rows between threads. Instantiated for the pairs of MLPP_FOR_EACH_SCALAR.
+template <typename T, typename Acc = accumulator_t<T>>
+void linear_outputs(Array2DView<const T> X, std::span<const T> W, std::span<const T> b, Array2DView<Acc> Z);
+// Same for one row, z = W*x + b
+template <typename T, typename Acc = accumulator_t<T>>
+void linear_outputs(std::span<const T> x, std::span<const T> W, std::span<const T> b, std::span<Acc> z);
+}// namespace ML
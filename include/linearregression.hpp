@@ -1,29 +1,91 @@
 #pragma once
 #include <cstddef>
+#include <span>
 #include <vector>
 #include "array2D.hpp"
 #include "regressormixin.hpp"
+#include "mlcommons.hpp"
+#include "parameters.hpp"
+#include "scalar.hpp"
 namespace ML
 {
-class LinearRegression: public RegressorMixin<LinearRegression>
+// Data and fitted parameters are stored as T, training and predictions are computed in Acc
+template <typename T, typename Acc = accumulator_t<T>>
+class BasicLinearRegression: public RegressorMixin<BasicLinearRegression<T, Acc>>
 {
 public:
-    LinearRegression() = default;
-    LinearRegression(float learning_rate, size_t max_iter);
-    LinearRegression(float learning_rate);
-    LinearRegression(size_t max_iter);
+    using value_type = T;
+    using accumulator_type = Acc;
 
-    LinearRegression& fit(const Array2D<float>& X, const std::vector<float>& y);
+    static constexpr size_t DEFAULT_MAX_ITER = 10000;
+    static constexpr float DEFAULT_LEARNING_RATE = 0.001;
+    static constexpr int DEFAULT_N_JOBS = 1;
+    static constexpr Solver DEFAULT_SOLVER = Solver::gradient_descent;
+    static constexpr float DEFAULT_L2_PENALTY = 0;
 
-    std::vector<float> predict(const Array2D<float>& X);
-    float predict(const std::vector<float>& x);
+    #ifdef __cpp_designated_initializers
+    struct ConstructorParams
+    {
+        float learning_rate = DEFAULT_LEARNING_RATE; //Not used by Solver::lbfgs and Solver::newton
+        size_t max_iter = DEFAULT_MAX_ITER;
+        int n_jobs = DEFAULT_N_JOBS; //Threads used by fit and by predict on large batches, -1 for all cores
+        Solver solver = DEFAULT_SOLVER;
+        SGDParams sgd = {}; //Only used by Solver::sgd, max_iter then counts epochs
+        StoppingParams stopping = {}; //Not used by Solver::normal_equations
+        float l2_penalty = DEFAULT_L2_PENALTY; //Only used by Solver::normal_equations
+    };
+    BasicLinearRegression(ConstructorParams p);
+    #endif
+
+    BasicLinearRegression() = default;
+    BasicLinearRegression(float learning_rate, size_t max_iter);
+    BasicLinearRegression(float learning_rate);
+    BasicLinearRegression(size_t max_iter);
+
+    BasicLinearRegression& fit(Array2DView<const T> X, const std::vector<T>& y);
+    // Trains on polynomial features without materializing them, see PolynomialFeatures::expand
+    BasicLinearRegression& fit(const BasicPolynomialExpansion<T>& X, const std::vector<T>& y);
+
+    // Batches are predicted by a blocked GEMV kernel, split over the n_jobs threads of a pool kept from fit (or load)
+    // when they are large. predict is const and a fitted model can be used from several threads at once, large batches
+    // of different threads take turns on the pool.
+    std::vector<Acc> predict(Array2DView<const T> X) const;
+    std::vector<Acc> predict(const BasicPolynomialExpansion<T>& X) const;
+    // Same into y_pred, which must have X.size() elements. Views are predicted without any heap allocation unless the
+    // batch is large enough to be split over several threads.
+    void predict_into(Array2DView<const T> X, std::span<Acc> y_pred) const;
+    void predict_into(const BasicPolynomialExpansion<T>& X, std::span<Acc> y_pred) const;
+    // Single sample, without allocating
+    Acc predict(std::span<const T> x) const;
+
+    // Iterations (epochs for Solver::sgd) run by the last fit
+    size_t n_iter() const { return n_iter_; }
+    // Loss after every iteration of the last fit, empty unless StoppingParams::record_loss was set
+    const std::vector<Acc>& loss_history() const { return loss_history_; }
 private:
-    float learning_rate_ = 0.001;
-    size_t max_iter_ = 10000;
+    friend struct ModelSerializer<BasicLinearRegression>;
+
+    template <typename Matrix>
+    BasicLinearRegression& fit_(const Matrix& X, const std::vector<T>& y);
+    template <typename Matrix>
+    void predict_into_(const Matrix& X, std::span<Acc> y_pred) const;
+
+    float learning_rate_ = DEFAULT_LEARNING_RATE;
+    size_t max_iter_ = DEFAULT_MAX_ITER;
+    int n_jobs_ = DEFAULT_N_JOBS;
+    Solver solver_ = DEFAULT_SOLVER;
+    SGDParams sgd_{};
+    StoppingParams stopping_{};
+    float l2_penalty_ = DEFAULT_L2_PENALTY;
 
-    size_t n_features_;
+    size_t n_features_ = 0;
+    size_t n_iter_ = 0;
+    std::vector<Acc> loss_history_{};
 
-    std::vector<float> w{};
-    float b;
+    ParameterArray<T> w{};
+    T b = 0;
+    //Threads of predict, started by the first batch large enough to be split (see detail::predict_blocks_)
+    LazyThreadPool predict_pool_;
 };
+using LinearRegression = BasicLinearRegression<float>;
 }
\ No newline at end of file
@@ -1,137 +1,359 @@
 #pragma once
 #include <algorithm>
+#include <array>
 #include <cstddef>
+#include <limits>
+#include <span>
 #include <vector>
 #include "mlcommons.hpp"
 #include "array2D.hpp"
 #include "classifiermixin.hpp"
+#include "parameters.hpp"
+#include "scalar.hpp"
 
 
 namespace ML
 {
-class LogisticRegression : public ClassifierMixin<LogisticRegression>
+// How more than two classes are handled: ovr fits one binary classifier per class, multinomial a single softmax model.
+// With two classes ovr is the usual binary logistic regression.
+enum class MultiClass { ovr, multinomial };
+
+// Data and fitted parameters are stored as T, training, outputs and probabilities are computed in Acc
+template <typename T, typename Acc = accumulator_t<T>>
+class BasicLogisticRegression : public ClassifierMixin<BasicLogisticRegression<T, Acc>>
 {
 public:
+    using value_type = T;
+    using accumulator_type = Acc;
+
     static constexpr size_t DEFAULT_MAX_ITER = 10000;
     static constexpr float DEFAULT_LEARNING_RATE = 0.001;
-    static constexpr bool DEFAULT_MULTICLASS = false;
+    static constexpr MultiClass DEFAULT_MULTICLASS = MultiClass::ovr;
+    static constexpr int DEFAULT_N_JOBS = 1;
+    static constexpr Solver DEFAULT_SOLVER = Solver::gradient_descent;
 
     #ifdef __cpp_designated_initializers
     struct ConstructorParams
     {
-        float learning_rate = DEFAULT_LEARNING_RATE;
+        float learning_rate = DEFAULT_LEARNING_RATE; //Not used by Solver::lbfgs and Solver::newton
         size_t max_iter = DEFAULT_MAX_ITER;
-        bool multiclass = DEFAULT_MULTICLASS;
+        MultiClass multiclass = DEFAULT_MULTICLASS;
+        int n_jobs = DEFAULT_N_JOBS; //Threads used by fit and by predict on large batches, -1 for all cores
+        Solver solver = DEFAULT_SOLVER;
+        SGDParams sgd = {}; //Only used by Solver::sgd, max_iter then counts epochs
+        StoppingParams stopping = {}; //Not used by Solver::normal_equations
     };
-        //Used as LogisticRegression lr({.max_iter=1000, .multiclass=true});
-    LogisticRegression(ConstructorParams p):
+        //Used as LogisticRegression lr({.max_iter=1000, .multiclass=MultiClass::multinomial});
+    BasicLogisticRegression(ConstructorParams p):
         learning_rate_(p.learning_rate),
-        max_iter_(p.max_iter)
-        //multiclass_(p.multiclass)
+        max_iter_(p.max_iter),
+        multiclass_(p.multiclass),
+        n_jobs_(p.n_jobs),
+        solver_(p.solver),
+        sgd_(p.sgd),
+        stopping_(p.stopping),
+        predict_pool_(p.n_jobs)
     {}
     #endif
 
-    LogisticRegression() = default;
+    BasicLogisticRegression() = default;
 
 
-    LogisticRegression(float learning_rate, size_t max_iter):
+    BasicLogisticRegression(float learning_rate, size_t max_iter):
         learning_rate_(learning_rate), max_iter_(max_iter)
     {}
-    LogisticRegression(float learning_rate): 
+    BasicLogisticRegression(float learning_rate): 
         learning_rate_(learning_rate) {}
-    LogisticRegression(size_t max_iter): 
+    BasicLogisticRegression(size_t max_iter): 
         max_iter_(max_iter) {}
 
+    // Sorted distinct labels of y, the column order of predict_proba
     void set_classes(const std::vector<int>& y)
     {
-        labels_.resize(2);
-        labels_[0] = y[0];
-        for (int i: y)
+        namespace ranges = std::ranges;
+        labels_ = y;
+        ranges::sort(labels_);
+        auto [last, end] = ranges::unique(labels_);
+        labels_.erase(last, end);
+        if (labels_.size() < 2)
         {
-            if (i != labels_[0])
+            throw std::invalid_argument(std::format("LogisticRegression needs samples of at least 2 classes, got {}", labels_.size()));
+        }
+    }
+    // Labels seen by fit (or set_classes), sorted: the column order of predict_proba
+    const std::vector<int>& classes() const { return labels_; }
+
+    BasicLogisticRegression& fit(Array2DView<const T> X, const std::vector<int>& y)
+    {
+        return fit_(X, y);
+    }
+    // Trains on polynomial features without materializing them, see PolynomialFeatures::expand
+    BasicLogisticRegression& fit(const BasicPolynomialExpansion<T>& X, const std::vector<int>& y)
+    {
+        return fit_(X, y);
+    }
+
+    // Batches are predicted by a blocked GEMV kernel, split over the n_jobs threads of a pool kept from fit (or load)
+    // when they are large. Prediction is const and a fitted model can be used from several threads at once, large
+    // batches of different threads take turns on the pool.
+    std::vector<int> predict(Array2DView<const T> X) const
+    {
+        std::vector<int> y_pred(X.size());
+        predict_into_(X, y_pred);
+        return y_pred;
+    }
+    std::vector<int> predict(const BasicPolynomialExpansion<T>& X) const
+    {
+        std::vector<int> y_pred(X.size());
+        predict_into_(X, y_pred);
+        return y_pred;
+    }
+    // Same into y_pred, which must have X.size() elements. Views are predicted without any heap allocation unless the
+    // batch is large enough to be split over several threads.
+    void predict_into(Array2DView<const T> X, std::span<int> y_pred) const
+    {
+        predict_into_(X, y_pred);
+    }
+    void predict_into(const BasicPolynomialExpansion<T>& X, std::span<int> y_pred) const
+    {
+        predict_into_(X, y_pred);
+    }
+    // Single sample, without allocating
+    int predict(std::span<const T> x) const
+    {
+        assert(x.size()==n_features_);
+        //Outputs one at a time, keeping the best, so nothing has to be allocated for them
+        size_t best = 0;
+        Acc best_z = -std::numeric_limits<Acc>::infinity();
+        for (size_t k=0; k<b.size(); k++)
+        {
+            Acc z;
+            linear_outputs<T, Acc>(x, std::span(w).subspan(k*n_features_, n_features_), std::span(b).subspan(k, 1), std::span(&z, 1));
+            if (z > best_z)
             {
-                labels_[1] = i;
-                break;
+                best = k;
+                best_z = z;
             }
         }
+        return labels_[b.size() == 1? (best_z >= 0):best];
     }
-    LogisticRegression& fit(const Array2D<float>& X, const std::vector<int>& y)
+    // Probability of every class (in the order of set_classes) for each sample, as one contiguous row per sample
+    Array2D<Acc> predict_proba(Array2DView<const T> X) const
     {
-        set_classes(y);
-        std::vector<float> y_bin(y.size());
+        return predict_proba_(X);
+    }
+    Array2D<Acc> predict_proba(const BasicPolynomialExpansion<T>& X) const
+    {
+        return predict_proba_(X);
+    }
+    // Same as a struct of arrays, into the n_classes x X.size() proba: proba[k] holds the probabilities of class k for
+    // every sample, contiguously. Allocates like predict_into.
+    void predict_proba_into(Array2DView<const T> X, Array2DView<Acc> proba) const
+    {
+        predict_proba_into_(X, proba);
+    }
+    void predict_proba_into(const BasicPolynomialExpansion<T>& X, Array2DView<Acc> proba) const
+    {
+        predict_proba_into_(X, proba);
+    }
+    // Single sample, into proba (one value per class)
+    void predict_proba(std::span<const T> x, std::span<Acc> proba) const
+    {
+        assert(x.size()==n_features_ and proba.size()==labels_.size());
+        linear_outputs<T, Acc>(x, w, b, b.size() == 1? proba.subspan(1):proba);
+        probabilities_(proba);
+    }
+
+    // Iterations (epochs for Solver::sgd) run by the last fit
+    size_t n_iter() const { return n_iter_; }
+    // Loss after every iteration of the last fit, empty unless StoppingParams::record_loss was set
+    const std::vector<Acc>& loss_history() const { return loss_history_; }
+private:
+    friend struct ModelSerializer<BasicLogisticRegression>;
+
+    template <typename Matrix>
+    BasicLogisticRegression& fit_(const Matrix& X, const std::vector<int>& y)
+    {
+        MLPP_PROFILE_DATA_SCOPE("LogisticRegression::fit", X.size(), X.size()*X.shape().second*sizeof(T));
+        if (solver_ == Solver::normal_equations)
+        {
+            throw std::invalid_argument("LogisticRegression has no closed-form solution, Solver::normal_equations is only supported by LinearRegression");
+        }
         namespace ranges = std::ranges;
-        ranges::transform(y, std::begin(y_bin), [this](int i) { return i == this->labels_[0]? 0.f:1.f; });
-        auto [gd_w, gd_b] = gradient_descent(X, y_bin, learning_rate_, max_iter_, log_cost_gradient);
-        w = std::move(gd_w);
-        b = gd_b;
-        n_features_ = X[0].size();
+        set_classes(y);
+        size_t n_classes = labels_.size();
+        n_features_ = X.shape().second;
+        if (n_classes == 2 and multiclass_ == MultiClass::ovr)
+        {
+            std::vector<T> y_bin(y.size());
+            ranges::transform(y, std::begin(y_bin), [this](int i) { return i == this->labels_[0]? T(0):T(1); });
+            BasicFitResult<Acc> solution = solve_(X, y_bin, BasicLogCostGradient<T, Acc>{});
+            w = detail::convert_<T>(std::move(solution.w));
+            b = std::vector<T>{static_cast<T>(solution.b)};
+            n_iter_ = solution.n_iter;
+            loss_history_ = std::move(solution.loss_history);
+        }
+        else
+        {
+            std::vector<size_t> y_idx(y.size());
+            ranges::transform(y, std::begin(y_idx), [this](int i) { return static_cast<size_t>(ranges::lower_bound(this->labels_, i) - std::begin(this->labels_)); });
+            BasicFitResult<std::vector<Acc>> solution = multiclass_ == MultiClass::ovr?
+                solve_(X, y_idx, BasicOvRLogCostGradient<T, Acc>{n_classes}):
+                solve_(X, y_idx, BasicSoftmaxCostGradient<T, Acc>{n_classes});
+            w = detail::convert_<T>(std::move(solution.w));
+            b = detail::convert_<T>(std::move(solution.b));
+            n_iter_ = solution.n_iter;
+            loss_history_ = std::move(solution.loss_history);
+        }
         return *this;
     }
 
-    std::vector<int> predict(const Array2D<float>& X)
+    // Calls f(i, z) for the rows i of [first, last) of X, z being the outputs of row i. They are computed a few rows at a
+    // time into a stack buffer, only models with more than OUTPUTS_BUFFER_SIZE_ outputs need the heap.
+    static constexpr size_t OUTPUTS_BUFFER_SIZE_ = 1024;
+    template <typename Matrix, typename F>
+    void for_each_outputs_(const Matrix& X, size_t first, size_t last, F f) const
     {
-        assert(X[0].size()==n_features_);
-        std::vector<int> y_pred;
-        y_pred.reserve(X.size());
-        for (auto sample: X)
+        size_t n_outputs = b.size();
+        std::array<Acc, OUTPUTS_BUFFER_SIZE_> stack_z;
+        std::vector<Acc> heap_z(n_outputs > stack_z.size()? n_outputs:0);
+        std::vector<T> buffer(detail::row_buffer_size_(X));
+        std::span<Acc> z = heap_z.empty()? std::span<Acc>(stack_z):std::span<Acc>(heap_z);
+        size_t step = z.size()/n_outputs;
+        for (size_t r=first; r<last; r+=step)
         {
-            float prob = std::round(find_prob(sample));
-
-            y_pred.push_back(labels_[static_cast<size_t>(prob)]);
+            size_t end = std::min(last, r+step);
+            Array2DView<Acc> Z(z.data(), end-r, n_outputs, n_outputs);
+            detail::linear_outputs_<T, Acc>(X, r, end, w, b, Z, buffer);
+            for (size_t i=r; i<end; i++)
+            {
+                f(i, Z[i-r]);
+            }
         }
+    }
 
-        return y_pred;
+    template <typename Matrix>
+    void predict_into_(const Matrix& X, std::span<int> y_pred) const
+    {
+        MLPP_PROFILE_DATA_SCOPE("LogisticRegression::predict", X.size(), X.size()*X.shape().second*sizeof(T));
+        assert(X.shape().second==n_features_ and y_pred.size()==X.size());
+        detail::predict_blocks_(X.size(), n_features_, predict_pool_, [&](size_t first, size_t last)
+        {
+            for_each_outputs_(X, first, last, [&](size_t i, std::span<Acc> z)
+            {
+                y_pred[i] = labels_[label_index_(z)];
+            });
+        });
     }
-    std::vector<std::pair<float, float>> predict_proba(const Array2D<float>& X)
+    template <typename Matrix>
+    void predict_proba_into_(const Matrix& X, Array2DView<Acc> proba) const
     {
-        assert(X[0].size()==n_features_);
-        std::vector<std::pair<float, float>> y_pred;
-        y_pred.reserve(X.size());
-        for (auto sample: X)
+        MLPP_PROFILE_DATA_SCOPE("LogisticRegression::predict_proba", X.size(), X.size()*X.shape().second*sizeof(T));
+        assert(X.shape().second==n_features_ and proba.shape()==std::make_pair(labels_.size(), X.size()));
+        detail::predict_blocks_(X.size(), n_features_, predict_pool_, [&](size_t first, size_t last)
         {
-            float prob = find_prob(sample);
-
-            y_pred.emplace_back(1-prob, prob);
-        }
-
-        return y_pred;
+            for_each_outputs_(X, first, last, [&](size_t i, std::span<Acc> z)
+            {
+                if (b.size() == 1)
+                {
+                    proba[1][i] = sigmoid<Acc>(z[0]);
+                    proba[0][i] = 1-proba[1][i];
+                    return;
+                }
+                probabilities_(z);
+                for (size_t k=0; k<z.size(); k++)
+                {
+                    proba[k][i] = z[k];
+                }
+            });
+        });
     }
-    
-    float score(const Array2D<float>& X, const std::vector<int>& y)
+    template <typename Matrix>
+    Array2D<Acc> predict_proba_(const Matrix& X) const
     {
-        std::vector<int> y_pred = predict(X);
-        size_t correct_preds = 0; 
-        for (auto [y_true_i, y_pred_i]: std::views::zip(y, y_pred))
+        MLPP_PROFILE_DATA_SCOPE("LogisticRegression::predict_proba", X.size(), X.size()*X.shape().second*sizeof(T));
+        assert(X.shape().second==n_features_);
+        Array2D<Acc> y_pred(X.size(), labels_.size());
+        detail::predict_blocks_(X.size(), n_features_, predict_pool_, [&](size_t first, size_t last)
         {
-            if (y_true_i == y_pred_i)
+            std::vector<T> buffer(detail::row_buffer_size_(X));
+            Array2DView<Acc> proba = y_pred.rows(first, last);
+            //Binary models have a single output, the logit of the second class
+            detail::linear_outputs_<T, Acc>(X, first, last, w, b, b.size() == 1? proba.cols(1, 2):proba, buffer);
+            for (auto row: proba)
             {
-                correct_preds++;
+                probabilities_(row);
             }
-        }
+        });
+        return y_pred;
+    }
 
-        return correct_preds/static_cast<float>(y_pred.size());
+    size_t label_index_(std::span<const Acc> z) const
+    {
+        return z.size() == 1? (z[0] >= 0) : std::ranges::max_element(z) - std::begin(z);
+    }
+    // Turns the outputs of a sample, stored in proba (in proba[1] for binary models), into class probabilities
+    void probabilities_(std::span<Acc> proba) const
+    {
+        if (b.size() == 1)
+        {
+            proba[1] = sigmoid<Acc>(proba[1]);
+            proba[0] = 1-proba[1];
+        }
+        else if (multiclass_ == MultiClass::multinomial)
+        {
+            softmax(proba);
+        }
+        else
+        {
+            //One-vs-rest probabilities are normalized to add up to 1, as scikit-learn does
+            std::ranges::transform(proba, std::begin(proba), sigmoid<Acc>);
+            Acc sum = std::ranges::fold_left(proba, Acc(0), std::plus<Acc>());
+            std::ranges::transform(proba, std::begin(proba), [sum](Acc p) { return p/sum; });
+        }
     }
-private:
 
-    float find_prob(std::span<const float> sample)
+    template <typename GradientFunction>
+    BasicFitResult<detail::bias_t<GradientFunction>> solve_(const SampleMatrix auto& X, const auto& y, GradientFunction gradient_function) const
     {
-        float pred = 0;
-        for (size_t i=0; i<n_features_; i++)
+        switch (solver_)
         {
-            pred += sample[i]*w[i];
+        case Solver::sgd:
+            return stochastic_gradient_descent(X, y, learning_rate_, max_iter_, gradient_function, sgd_, stopping_);
+        case Solver::lbfgs:
+            return lbfgs(X, y, max_iter_, gradient_function, n_jobs_, stopping_);
+        case Solver::newton:
+            if constexpr (std::is_same_v<GradientFunction, BasicLogCostGradient<T, Acc>>)
+            {
+                return newton(X, y, max_iter_, gradient_function, n_jobs_, stopping_);
+            }
+            else
+            {
+                throw std::invalid_argument("Solver::newton only supports binary problems, use Solver::lbfgs for multiclass");
+            }
+        default:
+            return gradient_descent(X, y, learning_rate_, max_iter_, gradient_function, n_jobs_, stopping_);
         }
-        pred += b;
-        float prob = sigmoid(pred);
-        return prob;
     }
 
     float learning_rate_ = DEFAULT_LEARNING_RATE;
     size_t max_iter_ = DEFAULT_MAX_ITER;
+    MultiClass multiclass_ = DEFAULT_MULTICLASS;
+    int n_jobs_ = DEFAULT_N_JOBS;
+    Solver solver_ = DEFAULT_SOLVER;
+    SGDParams sgd_{};
+    StoppingParams stopping_{};
 
-    size_t n_features_;
+    size_t n_features_ = 0;
+    size_t n_iter_ = 0;
+    std::vector<Acc> loss_history_{};
     std::vector<int> labels_;
 
-    std::vector<float> w{};
-    float b;
+    //One row of n_features_ weights and one bias per output, a single output for binary ovr problems
+    ParameterArray<T> w{};
+    ParameterArray<T> b{};
+    //Threads of predict, started by the first batch large enough to be split (see detail::predict_blocks_)
+    LazyThreadPool predict_pool_;
 };
-}
\ No newline at end of file
+using LogisticRegression = BasicLogisticRegression<float>;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace ML
+{
+// Read-only memory mapping of a whole file (mmap, or MapViewOfFile on Windows). Pages are read from disk the first
+// time they are touched. An empty file gives an empty mapping.
+class MappedFile
+{
+public:
+    // Throws std::runtime_error if the file can not be opened or mapped
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    std::span<const std::byte> bytes() const { return {base_, size_}; }
+    const char* chars() const { return reinterpret_cast<const char*>(base_); }
+    std::size_t size() const { return size_; }
+
+    // Asks the OS to start reading the whole file in the background, for when all of it is going to be used anyway
+    void prefetch() const;
+private:
+    void unmap_();
+
+    const std::byte* base_ = nullptr;
+    std::size_t size_ = 0;
+};
+}// namespace ML
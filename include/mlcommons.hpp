@@ -1,10 +1,23 @@
 #pragma once
+#include <array>
 #include <vector>
 #include <ranges>
 #include <algorithm>
 #include <cmath>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <limits>
+#include <format>
+#include <type_traits>
+#include <numeric>
 #include "array2D.hpp"
 #include "utils.hpp"
+#include "threadpool.hpp"
+#include "linalg.hpp"
+#include "scalar.hpp"
+#include "polynomialfeatures.hpp"
+#include "profiling.hpp"
 
 namespace ML
 {
@@ -36,27 +49,843 @@ consteval bool is_regressor()
 
 float accuracy_score(const std::vector<int>& y, const std::vector<int>& y_pred);
 
-float r2_score(const std::vector<float>& y, const std::vector<float>& y_pred);
+// Coefficient of determination of y from the residual sum of squares ((y - y_pred)**2).sum(), for callers that
+// accumulate it as they predict. The mean and variance of y are computed in S.
+template <typename T, typename S>
+S r2_score(const std::vector<T>& y, S residual_sum_of_squares)
+{
+    //v=((y_true - y_true.mean()) ** 2).sum()
+    S v{0};
+    S mean = std::ranges::fold_left(y.begin(), y.end(), S{0}, std::plus<S>()) / static_cast<S>(y.size());
+    for (S y_true_i: y)
+    {
+        v += (y_true_i-mean)*(y_true_i-mean);
+    }
+    return S{1}-(residual_sum_of_squares/v);
+}
+// Computed in the accumulator type of y and y_pred
+template <typename T, typename U>
+auto r2_score(const std::vector<T>& y, const std::vector<U>& y_pred)
+{
+    using S = accumulator_t<std::common_type_t<T, U>>;
+    //u=((y_true - y_pred)** 2).sum()
+    S u = 0;
+    for (auto [y_true_i, y_pred_i]: std::views::zip(y, y_pred))
+    {
+        S diff = static_cast<S>(y_true_i)-static_cast<S>(y_pred_i);
+        u += diff*diff;
+    }
+    return r2_score(y, u);
+}
 
 namespace ranges = std::ranges;
-std::pair<std::vector<float>, float> gradient_descent(const TwoDimensionalAccesible auto& X, const OneDimensionalAccesible auto& y, float alpha, size_t num_iters, auto gradient_function)
+
+// What the solvers read from X themselves, rows are only read by the gradient functions through detail::row_: an
+// Array2D, an Array2DView or a BasicPolynomialExpansion, value_type being the scalar type of its elements.
+template <typename T>
+concept SampleMatrix = requires(const T& X)
 {
-    
+    { X.size() } -> std::convertible_to<std::size_t>;
+    { X.shape() } -> std::convertible_to<std::pair<std::size_t, std::size_t>>;
+    typename T::value_type;
+};
+
+namespace detail
+{
+template <typename Matrix>
+using matrix_scalar_t = std::remove_cvref_t<Matrix>::value_type;
+
+// Row i of X. Views are read in place, lazy matrices (BasicPolynomialExpansion) build the row in buffer, which must
+// have at least row_buffer_size_(X) elements.
+template <typename T>
+std::span<const T> row_(Array2DView<const T> X, size_t i, std::type_identity_t<std::span<T>>)
+{
+    return X[i];
+}
+template <typename T>
+std::span<const T> row_(const BasicPolynomialExpansion<T>& X, size_t i, std::type_identity_t<std::span<T>> buffer)
+{
+    return X.row(i, buffer);
+}
+template <typename T>
+size_t row_buffer_size_(Array2DView<const T>)
+{
+    return 0;
+}
+template <typename T>
+size_t row_buffer_size_(const BasicPolynomialExpansion<T>& X)
+{
+    return X.buffer_size();
+}
+
+// Z = X*W^T + b for rows [first, last) of X, Z having one row per row of the range. Views go through the blocked
+// kernel directly, lazy matrices are expanded a row at a time into buffer first.
+template <typename T, typename Acc>
+void linear_outputs_(Array2DView<const T> X, size_t first, size_t last, std::span<const T> W, std::span<const T> b, Array2DView<Acc> Z, std::span<T>)
+{
+    linear_outputs<T, Acc>(X.rows(first, last), W, b, Z);
+}
+template <typename T, typename Acc>
+void linear_outputs_(const BasicPolynomialExpansion<T>& X, size_t first, size_t last, std::span<const T> W, std::span<const T> b, Array2DView<Acc> Z, std::span<T> buffer)
+{
+    for (size_t i=first; i<last; i++)
+    {
+        linear_outputs<T, Acc>(X.row(i, buffer), W, b, Z[i-first]);
+    }
+}
+
+inline constexpr size_t PREDICT_BLOCK_ROWS = 1024;
+// Batches with fewer rows*features than this are predicted on the calling thread, starting threads would cost more
+inline constexpr size_t PARALLEL_PREDICT_MIN_ELEMENTS = 1 << 18;
+
+// Calls f(first, last) for consecutive blocks of PREDICT_BLOCK_ROWS rows covering [0, n_rows), spread over the threads
+// of pool for large batches, so the pool is only started by the first of those. Blocks are independent, so f only has
+// to write its own rows of the output.
+template <typename F>
+void predict_blocks_(size_t n_rows, size_t n_features, const LazyThreadPool& pool, F f)
+{
+    size_t n_blocks = (n_rows+PREDICT_BLOCK_ROWS-1)/PREDICT_BLOCK_ROWS;
+    auto block = [&](size_t k) { f(k*PREDICT_BLOCK_ROWS, std::min(n_rows, (k+1)*PREDICT_BLOCK_ROWS)); };
+    if (n_rows*n_features < PARALLEL_PREDICT_MIN_ELEMENTS)
+    {
+        for (size_t k=0; k<n_blocks; k++)
+        {
+            block(k);
+        }
+        return;
+    }
+    pool.parallel_for(n_blocks, block);
+}
+
+// Type of the predictions of estimator for the rows of X
+template <typename Estimator, typename Matrix>
+using prediction_t = ranges::range_value_t<decltype(std::declval<const Estimator&>().predict(std::declval<const Matrix&>()))>;
+
+inline constexpr size_t SCORE_CHUNK_ROWS = 256;
+// Calls consume(i, prediction) for every row i of X without allocating the predictions: views are predicted
+// SCORE_CHUNK_ROWS rows at a time into a stack buffer through estimator.predict_into, lazy matrices a row at a time
+// through the single sample predict.
+template <typename Estimator, typename Matrix, typename Consume>
+void for_each_prediction_(const Estimator& estimator, const Matrix& X, Consume consume)
+{
+    using T = matrix_scalar_t<Matrix>;
+    if constexpr (std::is_convertible_v<const Matrix&, Array2DView<const T>>)
+    {
+        Array2DView<const T> view = X;
+        std::array<prediction_t<Estimator, Matrix>, SCORE_CHUNK_ROWS> y_pred;
+        for (size_t first=0; first<view.size(); first+=SCORE_CHUNK_ROWS)
+        {
+            size_t last = std::min(first+SCORE_CHUNK_ROWS, view.size());
+            estimator.predict_into(view.rows(first, last), std::span(y_pred).first(last-first));
+            for (size_t i=first; i<last; i++)
+            {
+                consume(i, y_pred[i-first]);
+            }
+        }
+    }
+    else
+    {
+        std::vector<T> buffer(row_buffer_size_(X));
+        for (size_t i=0; i<X.size(); i++)
+        {
+            consume(i, estimator.predict(row_(X, i, buffer)));
+        }
+    }
+}
+}// namespace detail
+
+// Parameters of a linear model with n_outputs outputs are a flat, output-major n_outputs x n_features weight vector w
+// and a bias b, which is a plain scalar for single-output models and a vector of n_outputs scalars otherwise. Solvers
+// keep them in the accumulator type of the gradient function.
+namespace detail
+{
+template <typename Bias>
+struct bias_scalar_
+{
+    using type = Bias;
+};
+template <typename S>
+struct bias_scalar_<std::vector<S>>
+{
+    using type = S;
+};
+template <typename Bias>
+using bias_scalar_t = bias_scalar_<Bias>::type;
+template <typename Bias>
+inline constexpr bool single_output_v = std::is_same_v<Bias, bias_scalar_t<Bias>>;
+
+template <typename Bias>
+Bias make_bias_(size_t n_outputs)
+{
+    if constexpr (single_output_v<Bias>)
+    {
+        assert(n_outputs == 1);
+        return 0;
+    }
+    else
+    {
+        return Bias(n_outputs, 0);
+    }
+}
+
+// Fitted parameters go from the accumulator type of the solver to the type the estimator stores them in
+template <typename T, typename S>
+std::vector<T> convert_(std::vector<S>&& v)
+{
+    if constexpr (std::is_same_v<T, S>)
+    {
+        return std::move(v);
+    }
+    else
+    {
+        return std::vector<T>(std::begin(v), std::end(v));
+    }
+}
+}// namespace detail
+
+// Gradient of the cost with respect to (w, b). Owned by the caller so the same buffers can be reused by every iteration.
+// When compute_cost is set the gradient functions also fill cost, the value of the cost at (w, b), in the same pass.
+// work (outputs) and row_buffer (rows of lazy matrices, of the sample type T) are scratch space that the gradient
+// functions size on first use.
+template <typename Bias, typename T = detail::bias_scalar_t<Bias>>
+struct BasicGradient
+{
+    using value_type = detail::bias_scalar_t<Bias>;
+
+    std::vector<value_type> dj_dw;
+    Bias dj_db{};
+    value_type cost = 0;
+    bool compute_cost = false;
+    std::vector<value_type> work{};
+    std::vector<T> row_buffer{};
+
+    BasicGradient() = default;
+    explicit BasicGradient(size_t n_features, bool compute_cost = false, size_t n_outputs = 1):
+        dj_dw(n_outputs*n_features, 0),
+        dj_db(detail::make_bias_<Bias>(n_outputs)),
+        compute_cost(compute_cost)
+    {}
+};
+using Gradient = BasicGradient<float>;
+using MultiGradient = BasicGradient<std::vector<float>>;
+
+// What a solver got to: the parameters, the iterations (epochs for sgd) actually run and, when requested, the monitored
+// loss after every one of them.
+template <typename Bias>
+struct BasicFitResult
+{
+    std::vector<detail::bias_scalar_t<Bias>> w;
+    Bias b{};
+    size_t n_iter = 0;
+    std::vector<detail::bias_scalar_t<Bias>> loss_history{};
+};
+using FitResult = BasicFitResult<float>;
+using MultiFitResult = BasicFitResult<std::vector<float>>;
+
+namespace detail
+{
+// Component-wise a = f(a, b) over parameter blocks, so solvers are written once for scalar and vector biases
+template <typename S, typename F>
+void update_components_(S& a, S b, F f)
+{
+    a = f(a, b);
+}
+template <typename S, typename F>
+void update_components_(std::vector<S>& a, const std::vector<S>& b, F f)
+{
+    ranges::transform(a, b, std::begin(a), f);
+}
 
-    float b = 0;
-    std::vector<float> w(X[0].size(), 0);
+template <typename S>
+S max_abs_(S a)
+{
+    return std::abs(a);
+}
+template <typename S>
+S max_abs_(const std::vector<S>& a)
+{
+    return ranges::fold_left(a, S(0), [](S m, S v) { return std::max(m, std::abs(v)); });
+}
+
+template <typename Bias, typename T>
+void add_gradient_(BasicGradient<Bias, T>& acc, const BasicGradient<Bias, T>& other)
+{
+    update_components_(acc.dj_dw, other.dj_dw, std::plus<>());
+    update_components_(acc.dj_db, other.dj_db, std::plus<>());
+    acc.cost += other.cost;
+}
+template <typename Bias, typename T>
+void copy_gradient_(BasicGradient<Bias, T>& dst, const BasicGradient<Bias, T>& src)
+{
+    auto second = [](auto, auto v) { return v; };
+    update_components_(dst.dj_dw, src.dj_dw, second);
+    update_components_(dst.dj_db, src.dj_db, second);
+    dst.cost = src.cost;
+}
+template <typename Bias, typename T>
+void scale_gradient_(BasicGradient<Bias, T>& grad, bias_scalar_t<Bias> scale)
+{
+    auto times = [scale](auto v, auto) { return v*scale; };
+    update_components_(grad.dj_dw, grad.dj_dw, times);
+    update_components_(grad.dj_db, grad.dj_db, times);
+    grad.cost *= scale;
+}
+template <typename Bias, typename T>
+void descend_(BasicFitResult<Bias>& params, const BasicGradient<Bias, T>& grad, float alpha)
+{
+    auto step = [alpha](auto w, auto dw) { return w-alpha*dw; };
+    update_components_(params.b, grad.dj_db, step);
+    update_components_(params.w, grad.dj_dw, step);
+}
+
+// Shapes the parameters and gradient of a solver after the gradient function: single-output ones (scalar bias_type)
+// have n_features weights, multi-output ones n_outputs() rows of them. gradient_type is the BasicGradient it fills.
+template <typename GradientFunction>
+using bias_t = std::remove_cvref_t<GradientFunction>::bias_type;
+template <typename GradientFunction>
+using gradient_t = std::remove_cvref_t<GradientFunction>::gradient_type;
+
+template <typename GradientFunction>
+size_t n_outputs_(const GradientFunction& gradient_function)
+{
+    if constexpr (single_output_v<bias_t<GradientFunction>>)
+    {
+        return 1;
+    }
+    else
+    {
+        return gradient_function.n_outputs();
+    }
+}
+}// namespace detail
+
+// Rows per shard when a gradient is split across threads. It does not depend on the number of threads, and neither
+// does the reduction tree built on top of it, so results are bit-identical for any n_jobs.
+inline constexpr size_t GRADIENT_SHARD_ROWS = 4096;
+
+// Computes a gradient over the first n_samples rows of X shard by shard on a thread pool and adds the partial results
+// up with a fixed-order pairwise tree. GradientFunction must accept a [first, last) row range (see LinearCostGradient).
+template <typename GradientFunction, typename GradientT>
+class ShardedGradient
+{
+public:
+    ShardedGradient(GradientFunction gradient_function, size_t n_samples, const GradientT& prototype, int n_jobs):
+        gradient_function_(gradient_function),
+        n_samples_(n_samples),
+        n_shards_(std::max<size_t>(1, (n_samples+GRADIENT_SHARD_ROWS-1)/GRADIENT_SHARD_ROWS)),
+        partials_(n_shards_ > 1? n_shards_:0, prototype),
+        pool_(std::min(effective_n_jobs(n_jobs), n_shards_))
+    {}
+
+    void operator()(const SampleMatrix auto& X, const OneDimensionalAccesible auto& y, const auto& w, const auto& b, GradientT& grad)
+    {
+        assert(X.size() >= n_samples_);
+        if (n_shards_ == 1)
+        {
+            gradient_function_(X, y, w, b, grad, 0, n_samples_);
+        }
+        else
+        {
+            pool_.parallel_for(n_shards_, [&](size_t shard)
+            {
+                size_t first = shard*GRADIENT_SHARD_ROWS;
+                partials_[shard].compute_cost = grad.compute_cost;
+                gradient_function_(X, y, w, b, partials_[shard], first, std::min(first+GRADIENT_SHARD_ROWS, n_samples_));
+            });
+            for (size_t stride=1; stride<n_shards_; stride*=2)
+            {
+                for (size_t shard=0; shard+stride<n_shards_; shard+=2*stride)
+                {
+                    detail::add_gradient_(partials_[shard], partials_[shard+stride]);
+                }
+            }
+            detail::copy_gradient_(grad, partials_[0]);
+        }
+
+        if (X.size() != n_samples_)
+        {
+            //The row range overloads scale by 1/X.size(), rescale to the mean over the rows actually used
+            detail::scale_gradient_(grad, static_cast<typename GradientT::value_type>(X.size())/n_samples_);
+        }
+    }
+private:
+    GradientFunction gradient_function_;
+    size_t n_samples_, n_shards_;
+    std::vector<GradientT> partials_;
+    ThreadPool pool_;
+};
+
+// gradient_norm stops as soon as the largest gradient component is <= tol. loss stops once the monitored loss has not
+// improved on the best one by at least tol for n_iter_no_change consecutive iterations. The monitored loss is the
+// training cost, or the cost on the last validation_fraction of the rows (which are then not trained on). Mini-batch
+// gradients are too noisy for gradient_norm, so stochastic_gradient_descent checks the loss rule once per epoch for
+// any criterion other than none.
+enum class StoppingCriterion { none, gradient_norm, loss };
+
+struct StoppingParams
+{
+    StoppingCriterion criterion = StoppingCriterion::gradient_norm;
+    float tol = 1e-4;
+    size_t n_iter_no_change = 5;
+    float validation_fraction = 0;
+    bool record_loss = false; //Fill FitResult::loss_history with the monitored loss
+};
+
+namespace detail
+{
+inline size_t n_training_rows(size_t n_samples, const StoppingParams& stopping)
+{
+    if (stopping.validation_fraction == 0)
+    {
+        return n_samples;
+    }
+    if (not (stopping.validation_fraction > 0 and stopping.validation_fraction < 1))
+    {
+        throw std::invalid_argument(std::format("validation_fraction must be in [0, 1), got {}", stopping.validation_fraction));
+    }
+    size_t n_validation = static_cast<size_t>(std::ceil(stopping.validation_fraction*n_samples));
+    if (n_validation >= n_samples)
+    {
+        throw std::invalid_argument("validation_fraction leaves no rows to train on");
+    }
+    return n_samples - n_validation;
+}
+
+// Feeds the per-iteration loss to the history and, when use_loss_rule is set, to the loss rule of StoppingParams
+template <typename S>
+class LossMonitor
+{
+public:
+    LossMonitor(const StoppingParams& stopping, bool use_loss_rule, size_t max_iter, std::vector<S>& history):
+        stopping_(stopping), use_loss_rule_(use_loss_rule), history_(history)
+    {
+        if (stopping_.record_loss)
+        {
+            history_.reserve(max_iter);
+        }
+    }
+    bool needs_loss() const
+    {
+        return stopping_.record_loss or use_loss_rule_;
+    }
+    // Returns true when training should stop
+    bool update(S loss)
+    {
+        if (stopping_.record_loss)
+        {
+            history_.push_back(loss);
+        }
+        if (not use_loss_rule_)
+        {
+            return false;
+        }
+        no_improvement_ = loss > best_loss_ - stopping_.tol? no_improvement_+1:0;
+        best_loss_ = std::min(best_loss_, loss);
+        return no_improvement_ >= stopping_.n_iter_no_change;
+    }
+private:
+    const StoppingParams& stopping_;
+    bool use_loss_rule_;
+    std::vector<S>& history_;
+    S best_loss_ = std::numeric_limits<S>::infinity();
+    size_t no_improvement_ = 0;
+};
+}// namespace detail
+
+// Full-batch gradient descent. Returns a BasicFitResult of the bias_type of the gradient function: a FitResult for
+// single-output float gradient functions and a MultiFitResult for multi-output ones.
+template <typename GradientFunction>
+auto gradient_descent(const SampleMatrix auto& X, const OneDimensionalAccesible auto& y, float alpha, size_t num_iters, GradientFunction gradient_function, int n_jobs = 1, const StoppingParams& stopping = {})
+{
+    using Bias = detail::bias_t<GradientFunction>;
+    using S = detail::bias_scalar_t<Bias>;
+    size_t n_train = detail::n_training_rows(X.size(), stopping);
+    bool validate = n_train != X.size();
+    size_t n_features = X.shape().second, n_outputs = detail::n_outputs_(gradient_function);
+
+    BasicFitResult<Bias> result{std::vector<S>(n_outputs*n_features, 0), detail::make_bias_<Bias>(n_outputs)};
+    detail::LossMonitor monitor(stopping, stopping.criterion == StoppingCriterion::loss, num_iters, result.loss_history);
+    //Allocated once, the loop below does not touch the heap
+    detail::gradient_t<GradientFunction> grad(n_features, monitor.needs_loss() and not validate, n_outputs);
+    ShardedGradient sharded_gradient(gradient_function, n_train, grad, n_jobs);
+    MLPP_PROFILE_DATA_SCOPE("gradient_descent", 0, 0);
     
     for (size_t i=0; i<num_iters; ++i)
     {
-        auto [dj_dw, dj_db] = gradient_function(X, y, w, b);
-        b = b - alpha*dj_db;
+        sharded_gradient(X, y, result.w, result.b, grad);
+        MLPP_PROFILE_ADD(n_train, n_train*n_features*sizeof(detail::matrix_scalar_t<decltype(X)>));
+        MLPP_PROFILE_ITERATION({"gradient_descent", i, static_cast<float>(std::max(detail::max_abs_(grad.dj_dw), detail::max_abs_(grad.dj_db))),
+            monitor.needs_loss() and not validate? static_cast<float>(grad.cost):std::numeric_limits<float>::quiet_NaN()});
+        if (stopping.criterion == StoppingCriterion::gradient_norm)
+        {
+            if (std::max(detail::max_abs_(grad.dj_dw), detail::max_abs_(grad.dj_db)) <= stopping.tol)
+            {
+                break;
+            }
+        }
+        if (monitor.needs_loss())
+        {
+            //The cost comes with the gradient at the current point, before this iteration's update
+            S loss = validate? gradient_function.cost(X, y, result.w, result.b, n_train, X.size())*X.size()/(X.size()-n_train) : grad.cost;
+            if (monitor.update(loss))
+            {
+                break;
+            }
+        }
+        detail::descend_(result, grad, alpha);
+        result.n_iter = i+1;
+    }
+
+    return result;
+}
+
+// lbfgs and newton are second-order methods that need no learning rate. newton solves for the exact Hessian every
+// iteration, so it is meant for small feature counts and needs a gradient function with a hessian (LogCostGradient).
+enum class Solver { gradient_descent, sgd, normal_equations, lbfgs, newton };
 
-        ranges::transform(w, dj_dw, std::begin(w), [alpha](float w,  float dw) { return w-alpha*dw; });
+// How the step size of stochastic_gradient_descent evolves with the update count t (starting at 1):
+// constant keeps eta0, invscaling uses eta0/t^power_t.
+enum class LearningRateSchedule { constant, invscaling };
+
+struct SGDParams
+{
+    size_t batch_size = 32;
+    LearningRateSchedule schedule = LearningRateSchedule::constant;
+    float power_t = 0.25;
+    bool shuffle = true;
+    std::size_t seed = -1; //-1 seeds from std::random_device
+};
+
+inline float scheduled_learning_rate(float eta0, size_t t, const SGDParams& params)
+{
+    switch (params.schedule)
+    {
+    case LearningRateSchedule::invscaling:
+        return eta0/std::pow(static_cast<float>(t), params.power_t);
+    case LearningRateSchedule::constant:
+    default:
+        return eta0;
     }
+}
 
-    return {std::move(w), b};
+// Mini-batch gradient descent: every epoch walks a permutation of the row indices in batches of params.batch_size, so
+// rows are never copied. num_epochs counts full passes over X. gradient_function must accept a span of row indices
+// (see LinearCostGradient). Without a validation split, the loss checked at the end of each epoch is the mean of the
+// mini-batch costs seen during it.
+template <typename GradientFunction>
+auto stochastic_gradient_descent(const SampleMatrix auto& X, const OneDimensionalAccesible auto& y, float eta0, size_t num_epochs, GradientFunction gradient_function, const SGDParams& params = {}, const StoppingParams& stopping = {})
+{
+    MLPP_PROFILE_SCOPE("stochastic_gradient_descent");
+    using Bias = detail::bias_t<GradientFunction>;
+    using S = detail::bias_scalar_t<Bias>;
+    if (params.batch_size == 0)
+    {
+        throw std::invalid_argument("batch_size must be at least 1");
+    }
+    std::size_t seed = params.seed;
+    if (seed == static_cast<std::size_t>(-1))
+    {
+        std::random_device dev;
+        seed = dev();
+    }
+    std::mt19937 rng(seed);
+
+    size_t n = X.size();
+    size_t n_train = detail::n_training_rows(n, stopping);
+    bool validate = n_train != n;
+    size_t n_features = X.shape().second, n_outputs = detail::n_outputs_(gradient_function);
+
+    BasicFitResult<Bias> result{std::vector<S>(n_outputs*n_features, 0), detail::make_bias_<Bias>(n_outputs)};
+    detail::LossMonitor monitor(stopping, stopping.criterion != StoppingCriterion::none, num_epochs, result.loss_history);
+    detail::gradient_t<GradientFunction> grad(n_features, monitor.needs_loss() and not validate, n_outputs);
+    std::vector<size_t> order(n_train);
+    ranges::iota(order, 0uz);
+
+    size_t t = 0;
+    for (size_t epoch=0; epoch<num_epochs; ++epoch)
+    {
+        if (params.shuffle)
+        {
+            ranges::shuffle(order, rng);
+        }
+        double epoch_cost = 0;
+        for (size_t first=0; first<n_train; first+=params.batch_size)
+        {
+            std::span<const size_t> batch(order.data()+first, std::min(params.batch_size, n_train-first));
+            gradient_function(X, y, result.w, result.b, grad, batch);
+            epoch_cost += static_cast<double>(grad.cost)*batch.size();
+
+            detail::descend_(result, grad, scheduled_learning_rate(eta0, ++t, params));
+        }
+        result.n_iter = epoch+1;
+
+        if (monitor.needs_loss())
+        {
+            S loss = validate? gradient_function.cost(X, y, result.w, result.b, n_train, n)*n/(n-n_train) : epoch_cost/n_train;
+            if (monitor.update(loss))
+            {
+                break;
+            }
+        }
+    }
+
+    return result;
 }
 
+namespace detail
+{
+// Flat [w b] view of the parameters for the quasi-Newton solvers
+template <typename S, typename Bias>
+void pack_(const std::vector<S>& w, const Bias& b, std::vector<S>& theta)
+{
+    ranges::copy(w, std::begin(theta));
+    if constexpr (single_output_v<Bias>)
+    {
+        theta[w.size()] = b;
+    }
+    else
+    {
+        ranges::copy(b, std::begin(theta)+w.size());
+    }
+}
+template <typename S, typename Bias>
+void unpack_(const std::vector<S>& theta, std::vector<S>& w, Bias& b)
+{
+    std::copy_n(std::begin(theta), w.size(), std::begin(w));
+    if constexpr (single_output_v<Bias>)
+    {
+        b = theta[w.size()];
+    }
+    else
+    {
+        std::copy_n(std::begin(theta)+w.size(), b.size(), std::begin(b));
+    }
+}
+
+template <typename S>
+double dot_(const std::vector<S>& a, const std::vector<S>& b)
+{
+    return std::inner_product(std::begin(a), std::end(a), std::begin(b), 0.);
+}
+}// namespace detail
+
+// Limited-memory BFGS with a backtracking (Armijo) line search, on the cost and gradient of gradient_function (the cost
+// is fused in the same pass as the gradient). memory is the number of correction pairs kept. All buffers are allocated
+// up front, and gradients are sharded over n_jobs threads like in gradient_descent.
+template <typename GradientFunction>
+auto lbfgs(const SampleMatrix auto& X, const OneDimensionalAccesible auto& y, size_t max_iter, GradientFunction gradient_function, int n_jobs = 1, const StoppingParams& stopping = {}, size_t memory = 10)
+{
+    MLPP_PROFILE_SCOPE("lbfgs");
+    using Bias = detail::bias_t<GradientFunction>;
+    using S = detail::bias_scalar_t<Bias>;
+    constexpr float ARMIJO_C = 1e-4;
+    constexpr size_t MAX_LINE_SEARCH = 30;
+    if (memory == 0)
+    {
+        throw std::invalid_argument("lbfgs needs a memory of at least 1 correction pair");
+    }
+
+    size_t n = X.size();
+    size_t n_train = detail::n_training_rows(n, stopping);
+    bool validate = n_train != n;
+    size_t n_features = X.shape().second, n_outputs = detail::n_outputs_(gradient_function);
+    size_t n_params = n_outputs*(n_features+1);
+
+    BasicFitResult<Bias> result{std::vector<S>(n_outputs*n_features, 0), detail::make_bias_<Bias>(n_outputs)};
+    detail::LossMonitor monitor(stopping, stopping.criterion == StoppingCriterion::loss, max_iter, result.loss_history);
+    detail::gradient_t<GradientFunction> grad(n_features, true, n_outputs);
+    ShardedGradient sharded_gradient(gradient_function, n_train, grad, n_jobs);
+
+    std::vector<S> theta(n_params, 0), g(n_params), theta_new(n_params), g_new(n_params), direction(n_params);
+    std::vector<S> s_new(n_params), y_new(n_params);
+    Array2D<S> s_hist(memory, n_params), y_hist(memory, n_params);
+    std::vector<double> rho(memory), alpha(memory);
+    size_t n_hist = 0, newest = 0;
+
+    //Cost and gradient at theta, left in result (parameters) and grad
+    auto evaluate = [&](const std::vector<S>& at, std::vector<S>& g_out)
+    {
+        detail::unpack_(at, result.w, result.b);
+        sharded_gradient(X, y, result.w, result.b, grad);
+        detail::pack_(grad.dj_dw, grad.dj_db, g_out);
+        return grad.cost;
+    };
+    S cost = evaluate(theta, g);
+
+    for (size_t iter=0; iter<max_iter; ++iter)
+    {
+        if (stopping.criterion == StoppingCriterion::gradient_norm and detail::max_abs_(g) <= stopping.tol)
+        {
+            break;
+        }
+        if (monitor.needs_loss())
+        {
+            S loss = validate? gradient_function.cost(X, y, result.w, result.b, n_train, n)*n/(n-n_train) : cost;
+            if (monitor.update(loss))
+            {
+                break;
+            }
+        }
+
+        //Two-loop recursion: direction = -H*g with H the L-BFGS inverse Hessian approximation
+        ranges::copy(g, std::begin(direction));
+        for (size_t h=0; h<n_hist; h++)
+        {
+            size_t i = (newest+memory-h)%memory;
+            alpha[i] = rho[i]*std::inner_product(std::begin(s_hist[i]), std::end(s_hist[i]), std::begin(direction), 0.);
+            ranges::transform(direction, y_hist[i], std::begin(direction), [a = alpha[i]](S d, S yv) { return d - a*yv; });
+        }
+        double gamma = 1;
+        if (n_hist > 0)
+        {
+            auto y_last = y_hist[newest];
+            gamma = 1/(rho[newest]*std::inner_product(std::begin(y_last), std::end(y_last), std::begin(y_last), 0.));
+        }
+        else
+        {
+            //First step: unit length along -g
+            gamma = 1/std::max(std::sqrt(detail::dot_(g, g)), 1e-12);
+        }
+        ranges::transform(direction, std::begin(direction), [gamma](S d) { return d*gamma; });
+        for (size_t h=n_hist; h-- > 0;)
+        {
+            size_t i = (newest+memory-h)%memory;
+            double beta = rho[i]*std::inner_product(std::begin(y_hist[i]), std::end(y_hist[i]), std::begin(direction), 0.);
+            ranges::transform(direction, s_hist[i], std::begin(direction), [c = alpha[i]-beta](S d, S s) { return d + c*s; });
+        }
+        ranges::transform(direction, std::begin(direction), std::negate<S>());
+
+        double slope = detail::dot_(g, direction);
+        if (not (slope < 0))
+        {
+            //Not a descent direction (bad curvature pairs): restart from steepest descent
+            n_hist = 0;
+            ranges::transform(g, std::begin(direction), std::negate<S>());
+            slope = -detail::dot_(g, g);
+        }
+
+        float step = 1;
+        S new_cost = cost;
+        bool accepted = false;
+        for (size_t ls=0; ls<MAX_LINE_SEARCH and not accepted; ls++, step /= 2)
+        {
+            ranges::transform(theta, direction, std::begin(theta_new), [step](S t, S d) { return t + step*d; });
+            new_cost = evaluate(theta_new, g_new);
+            accepted = new_cost <= cost + ARMIJO_C*step*slope;
+        }
+        if (not accepted)
+        {
+            //No decrease representable in the precision of S, theta is as good as it gets
+            detail::unpack_(theta, result.w, result.b);
+            break;
+        }
+
+        //The pair only enters the ring (over the oldest one once it is full) if its curvature is positive, a rejected
+        //pair must not clobber a live one whose rho is still used
+        ranges::transform(theta_new, theta, std::begin(s_new), std::minus<S>());
+        ranges::transform(g_new, g, std::begin(y_new), std::minus<S>());
+        double sy = std::inner_product(std::begin(s_new), std::end(s_new), std::begin(y_new), 0.);
+        if (sy > 1e-10)
+        {
+            size_t slot = n_hist == 0? newest:(newest+1)%memory;
+            ranges::copy(s_new, std::begin(s_hist[slot]));
+            ranges::copy(y_new, std::begin(y_hist[slot]));
+            rho[slot] = 1/sy;
+            newest = slot;
+            n_hist = std::min(n_hist+1, memory);
+        }
+
+        std::swap(theta, theta_new);
+        std::swap(g, g_new);
+        cost = new_cost;
+        result.n_iter = iter+1;
+    }
+
+    return result;
+}
+
+// Newton's method (IRLS for the logistic cost) with a backtracking line search: every iteration solves the
+// (n_features+1)^2 Hessian system, built in one blocked pass over the data by gradient_function.hessian.
+template <typename GradientFunction>
+BasicFitResult<detail::bias_t<GradientFunction>> newton(const SampleMatrix auto& X, const OneDimensionalAccesible auto& y, size_t max_iter, GradientFunction gradient_function, int n_jobs = 1, const StoppingParams& stopping = {})
+{
+    MLPP_PROFILE_SCOPE("newton");
+    using S = detail::bias_t<GradientFunction>;
+    constexpr float ARMIJO_C = 1e-4;
+    constexpr size_t MAX_LINE_SEARCH = 30;
+
+    size_t n = X.size();
+    size_t n_train = detail::n_training_rows(n, stopping);
+    bool validate = n_train != n;
+    size_t n_features = X.shape().second;
+
+    BasicFitResult<S> result{std::vector<S>(n_features, 0)};
+    detail::LossMonitor monitor(stopping, stopping.criterion == StoppingCriterion::loss, max_iter, result.loss_history);
+    detail::gradient_t<GradientFunction> grad(n_features, true);
+    ShardedGradient sharded_gradient(gradient_function, n_train, grad, n_jobs);
+    Array2D<double> hessian(n_features+1, n_features+1);
+    std::vector<double> delta(n_features+1);
+    std::vector<S> w_new(n_features);
+    S train_scale = static_cast<S>(n)/n_train;
+
+    sharded_gradient(X, y, result.w, result.b, grad);
+    for (size_t iter=0; iter<max_iter; ++iter)
+    {
+        if (stopping.criterion == StoppingCriterion::gradient_norm and std::max(detail::max_abs_(grad.dj_dw), std::abs(grad.dj_db)) <= stopping.tol)
+        {
+            break;
+        }
+        if (monitor.needs_loss())
+        {
+            S loss = validate? gradient_function.cost(X, y, result.w, result.b, n_train, n)*n/(n-n_train) : grad.cost;
+            if (monitor.update(loss))
+            {
+                break;
+            }
+        }
+
+        gradient_function.hessian(X, result.w, result.b, hessian, 0, n_train);
+        std::copy_n(std::begin(grad.dj_dw), n_features, std::begin(delta));
+        delta[n_features] = grad.dj_db;
+        for (auto row: hessian)
+        {
+            ranges::transform(row, std::begin(row), [train_scale](double h) { return h*train_scale; });
+        }
+        symmetric_solve(hessian, delta);
+
+        double slope = -std::inner_product(std::begin(grad.dj_dw), std::end(grad.dj_dw), std::begin(delta), static_cast<double>(grad.dj_db)*delta[n_features]);
+        S cost = grad.cost, b_new = result.b;
+        float step = 1;
+        bool accepted = false;
+        for (size_t ls=0; ls<MAX_LINE_SEARCH and not accepted; ls++, step /= 2)
+        {
+            ranges::transform(result.w, delta, std::begin(w_new), [step](S w, double d) { return static_cast<S>(w - step*d); });
+            b_new = static_cast<S>(result.b - step*delta[n_features]);
+            accepted = gradient_function.cost(X, y, w_new, b_new, 0, n_train)*train_scale <= cost + ARMIJO_C*step*slope;
+        }
+        if (not accepted)
+        {
+            break;
+        }
+        std::swap(result.w, w_new);
+        result.b = b_new;
+        sharded_gradient(X, y, result.w, result.b, grad);
+        result.n_iter = iter+1;
+    }
+
+    return result;
+}
+
+// Closed-form (ridge) least squares: accumulates [X 1]^T[X 1] and [X 1]^T*y in double precision in one blocked pass
+// over X and solves the normal equations by Cholesky. When they are too ill-conditioned, it falls back to a pivoted QR
+// of the centred rows, streamed into an n_features x n_features factor so that X (or the expansion) is never copied.
+// l2_penalty is added to the diagonal of the weights (never the bias), on the same scale as scikit-learn's
+// Ridge alpha. T is deduced from y, the solution is returned in Acc.
+template <typename T, typename Acc = accumulator_t<T>>
+BasicFitResult<Acc> least_squares(Array2DView<const std::type_identity_t<T>> X, const std::vector<T>& y, float l2_penalty = 0);
+template <typename T, typename Acc = accumulator_t<T>>
+BasicFitResult<Acc> least_squares(const BasicPolynomialExpansion<T>& X, const std::vector<T>& y, float l2_penalty = 0);
+
 float linear_cost_function(const std::ranges::range auto& X, const ranges::range auto& y, const ranges::range auto& w, float b)
 {
     auto n = X.size();
@@ -70,9 +899,101 @@ float linear_cost_function(const std::ranges::range auto& X, const ranges::range
     return total_cost/(2*n);
 }
 
-std::pair<std::vector<float>, float> linear_cost_gradient(const Array2D<float>& X, const std::vector<float>& y, const std::vector<float>& w, float b);
+// Gradient functions of the linear models, on samples of type T with parameters, gradient and cost in Acc. Their
+// members are compiled for the pairs of MLPP_FOR_EACH_SCALAR.
 
-float sigmoid(float z);
+// Members of a gradient function on samples of type Matrix, targets y of type Y and a bias of type B: the gradient over
+// all rows, a row range and a list of rows, and the cost over all rows and a row range.
+#define MLPP_DECLARE_GRADIENT_MEMBERS_(Matrix, Y, B) \
+    void operator()(Matrix X, const Y& y, const std::vector<Acc>& w, B b, gradient_type& grad) const; \
+    void operator()(Matrix X, const Y& y, const std::vector<Acc>& w, B b, gradient_type& grad, size_t first, size_t last) const; \
+    void operator()(Matrix X, const Y& y, const std::vector<Acc>& w, B b, gradient_type& grad, std::span<const size_t> rows) const; \
+    Acc cost(Matrix X, const Y& y, const std::vector<Acc>& w, B b) const; \
+    Acc cost(Matrix X, const Y& y, const std::vector<Acc>& w, B b, size_t first, size_t last) const;
 
-std::pair<std::vector<float>, float> log_cost_gradient(const Array2D<float>& X, const std::vector<float>& y, const std::vector<float>& w, float b);
-}
\ No newline at end of file
+// Gradient of the squared error cost. The row range overload only accumulates rows [first, last), still scaled by
+// 1/X.size(), so that the partial gradients of disjoint ranges add up to the full one. The row index overload is the
+// mean gradient of just those rows (a mini-batch). cost evaluates the cost alone, with the same row conventions.
+template <typename T, typename Acc = accumulator_t<T>>
+struct BasicLinearCostGradient
+{
+    using bias_type = Acc;
+    using gradient_type = BasicGradient<Acc, T>;
+
+    MLPP_FOR_EACH_SAMPLE_MATRIX(MLPP_DECLARE_GRADIENT_MEMBERS_, std::vector<T>, Acc)
+};
+using LinearCostGradient = BasicLinearCostGradient<float>;
+inline constexpr LinearCostGradient linear_cost_gradient{};
+
+template <typename S>
+S sigmoid(S z)
+{
+    z = std::clamp(z, S(-500), S(500));
+    return S(1) / (S(1)+std::exp(-z));
+}
+
+// Gradient of the logistic (cross-entropy) cost, same conventions as BasicLinearCostGradient.
+template <typename T, typename Acc = accumulator_t<T>>
+struct BasicLogCostGradient
+{
+    using bias_type = Acc;
+    using gradient_type = BasicGradient<Acc, T>;
+
+    MLPP_FOR_EACH_SAMPLE_MATRIX(MLPP_DECLARE_GRADIENT_MEMBERS_, std::vector<T>, Acc)
+
+    // Hessian of the cost with respect to [w b] over rows [first, last) (scaled by 1/X.size()), H is resized if needed
+    void hessian(Array2DView<const T> X, const std::vector<Acc>& w, Acc b, Array2D<double>& H, size_t first, size_t last) const;
+    void hessian(const BasicPolynomialExpansion<T>& X, const std::vector<Acc>& w, Acc b, Array2D<double>& H, size_t first, size_t last) const;
+};
+using LogCostGradient = BasicLogCostGradient<float>;
+inline constexpr LogCostGradient log_cost_gradient{};
+
+// Gradients of K-output logistic models on class indices y in [0, n_classes). w holds one row of weights per class.
+// OvRLogCostGradient is the sum of the n_classes binary one-vs-rest problems, trained together so that each row is
+// read once per iteration for all of them; SoftmaxCostGradient is the multinomial (softmax cross-entropy) cost.
+// Rows are processed in blocks: the block's K outputs are computed first, then folded into every class's gradient.
+// Same row conventions as BasicLinearCostGradient.
+template <typename T, typename Acc = accumulator_t<T>>
+struct BasicOvRLogCostGradient
+{
+    using bias_type = std::vector<Acc>;
+    using gradient_type = BasicGradient<std::vector<Acc>, T>;
+    size_t n_classes;
+
+    size_t n_outputs() const { return n_classes; }
+
+    MLPP_FOR_EACH_SAMPLE_MATRIX(MLPP_DECLARE_GRADIENT_MEMBERS_, std::vector<size_t>, const std::vector<Acc>&)
+};
+using OvRLogCostGradient = BasicOvRLogCostGradient<float>;
+
+template <typename T, typename Acc = accumulator_t<T>>
+struct BasicSoftmaxCostGradient
+{
+    using bias_type = std::vector<Acc>;
+    using gradient_type = BasicGradient<std::vector<Acc>, T>;
+    size_t n_classes;
+
+    size_t n_outputs() const { return n_classes; }
+
+    MLPP_FOR_EACH_SAMPLE_MATRIX(MLPP_DECLARE_GRADIENT_MEMBERS_, std::vector<size_t>, const std::vector<Acc>&)
+};
+using SoftmaxCostGradient = BasicSoftmaxCostGradient<float>;
+#undef MLPP_DECLARE_GRADIENT_MEMBERS_
+
+// In-place softmax of a row of K outputs
+template <typename S>
+void softmax(std::span<S> z)
+{
+    S max_z = *ranges::max_element(z);
+    S sum = 0;
+    for (S& v: z)
+    {
+        v = std::exp(v-max_z);
+        sum += v;
+    }
+    for (S& v: z)
+    {
+        v /= sum;
+    }
+}
+}
@@ -0,0 +1,227 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "dataset.hpp"
+#include "mappedfile.hpp"
+#include "parameters.hpp"
+#include "linearregression.hpp"
+#include "logsticregression.hpp"
+#include "zscorenormalizer.hpp"
+#include "polynomialfeatures.hpp"
+#include "pipeline.hpp"
+
+namespace ML
+{
+// Binary model files: a 64-byte header, a table of sections, then the sections themselves, each one a typed array
+// starting on a 64-byte boundary, in native byte order. A file holds one or more fitted models (the steps of a Pipeline
+// for instance) and every section is tagged with the model it belongs to. Loading maps the file: the weights of the
+// linear models are used in place from the mapping, the small state (labels, normalizer statistics, polynomial plan)
+// is copied. Only the fitted state and what prediction uses (n_jobs, multiclass) are saved, training hyperparameters
+// go back to their defaults. Sections keep the scalar types of the model that saved them, so a file loads into the same
+// instantiation only: a BasicLinearRegression<double> file is rejected by load_model<LinearRegression>.
+//
+//     save_models("model.mlpp", pipe);
+//     auto served = load_model<Pipeline<ZScoreNormalizer, LinearRegression>>("model.mlpp");
+
+enum class ModelType : std::uint32_t { linear_regression = 1, logistic_regression = 2, zscore_normalizer = 3, polynomial_features = 4 };
+enum class ModelField : std::uint32_t { config = 1, weights = 2, bias = 3, labels = 4, moments = 5, scale = 6, shift = 7, inverse_scale = 8, inverse_shift = 9, plan = 10 };
+
+struct ModelHeader
+{
+    static constexpr char MAGIC[8] = {'M', 'L', 'P', 'P', 'M', 'O', 'D', 'L'};
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::uint32_t ENDIAN_TAG = 0x01020304; //Reads differently on a machine with the other byte order
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t endian_tag;
+    std::uint64_t n_models;
+    std::uint64_t n_sections;
+    std::uint64_t sections_offset;
+    std::uint64_t file_size;
+    std::uint64_t reserved[2];
+};
+struct ModelSection
+{
+    std::uint32_t model; //Index of the model in the file
+    ModelType type; //Type of that model
+    ModelField field;
+    DType dtype;
+    std::uint64_t offset;
+    std::uint64_t count; //Elements, not bytes
+};
+static_assert(sizeof(ModelHeader) == ModelHeader::ALIGNMENT and std::is_trivially_copyable_v<ModelHeader>);
+static_assert(sizeof(ModelSection) == 32 and std::is_trivially_copyable_v<ModelSection>);
+static_assert(sizeof(double) == 8);
+
+namespace detail
+{
+template <typename T>
+consteval DType dtype_of_()
+{
+    if constexpr (std::is_same_v<T, float>) return DType::float32;
+    else if constexpr (std::is_same_v<T, double>) return DType::float64;
+    else if constexpr (std::is_same_v<T, std::int32_t>) return DType::int32;
+    else if constexpr (std::is_same_v<T, std::int64_t>) return DType::int64;
+    else if constexpr (std::is_same_v<T, std::uint32_t>) return DType::uint32;
+#ifdef MLPP_HAS_FLOAT16
+    else if constexpr (std::is_same_v<T, float16>) return DType::float16;
+#endif
+    else static_assert(sizeof(T) == 0, "Unsupported model section type");
+}
+}// namespace detail
+
+// Collects the sections of the models passed to save_models, then writes them in one go
+class ModelWriter
+{
+public:
+    // Sections added from now on belong to a new model of this type
+    void begin_model(ModelType type);
+    template <typename T>
+    void add(ModelField field, std::span<const T> values)
+    {
+        auto bytes = std::as_bytes(values);
+        sections_.push_back({{static_cast<std::uint32_t>(n_models_-1), type_, field, detail::dtype_of_<T>(), 0, values.size()}, {std::begin(bytes), std::end(bytes)}});
+    }
+    // Replaces the file. Throws std::runtime_error on I/O errors.
+    void write(const std::string& path) const;
+private:
+    struct Pending_
+    {
+        ModelSection section;
+        std::vector<std::byte> bytes;
+    };
+    std::vector<Pending_> sections_;
+    ModelType type_{};
+    std::size_t n_models_ = 0;
+};
+
+// Read-only memory mapping of a model file. Models loaded from it keep the mapping alive as long as they borrow from it,
+// so they can outlive the MappedModels.
+class MappedModels
+{
+public:
+    // Throws std::runtime_error if the file can not be mapped or is not a valid model file for this machine
+    explicit MappedModels(const std::string& path);
+
+    std::size_t size() const { return header_->n_models; }
+    ModelType type(std::size_t model) const;
+
+    // Model number first of the file, or the steps of a Pipeline starting there. Throws std::runtime_error if the file
+    // holds something else.
+    template <typename Model>
+    Model load(std::size_t first = 0) const
+    {
+        if (first + ModelSerializer<Model>::N_MODELS > size())
+        {
+            throw std::runtime_error(std::format("Model file {} has {} models, can not load {} from model {}", path_, size(), ModelSerializer<Model>::N_MODELS, first));
+        }
+        return ModelSerializer<Model>::load(*this, first);
+    }
+
+    // Section field of model, which must have count elements unless count is std::dynamic_extent. Points into the mapping.
+    template <typename T>
+    std::span<const T> section(std::size_t model, ModelField field, std::size_t count = std::dynamic_extent) const
+    {
+        const ModelSection& s = find_(model, field, detail::dtype_of_<T>(), count);
+        return {reinterpret_cast<const T*>(file_->bytes().data()+s.offset), s.count};
+    }
+    // Same, as parameters borrowed from the mapping
+    template <typename T>
+    ParameterArray<T> borrow(std::size_t model, ModelField field, std::size_t count = std::dynamic_extent) const
+    {
+        return ParameterArray<T>(section<T>(model, field, count), file_);
+    }
+    template <typename T>
+    std::vector<T> copy(std::size_t model, ModelField field, std::size_t count = std::dynamic_extent) const
+    {
+        std::span<const T> values = section<T>(model, field, count);
+        return {std::begin(values), std::end(values)};
+    }
+    // Throws std::runtime_error unless model has the given type
+    void expect(std::size_t model, ModelType type) const;
+    // Throws std::runtime_error with what is wrong with the file
+    [[noreturn]] void corrupt(std::string_view what) const;
+private:
+    const ModelSection& find_(std::size_t model, ModelField field, DType dtype, std::size_t count) const;
+
+    std::string path_;
+    std::shared_ptr<const MappedFile> file_;
+    const ModelHeader* header_ = nullptr; //Points into file_
+    std::span<const ModelSection> sections_;
+};
+
+// Writes the fitted models to path in order, replacing the file. Throws std::logic_error if one is not fitted and
+// std::runtime_error on I/O errors.
+template <typename... Models>
+void save_models(const std::string& path, const Models&... models)
+{
+    ModelWriter writer;
+    (ModelSerializer<Models>::save(writer, models), ...);
+    writer.write(path);
+}
+template <typename Model>
+Model load_model(const std::string& path)
+{
+    return MappedModels(path).load<Model>();
+}
+
+// Defined in modelfile.cpp for the pairs of MLPP_FOR_EACH_SCALAR
+template <typename T, typename Acc>
+struct ModelSerializer<BasicLinearRegression<T, Acc>>
+{
+    static constexpr std::size_t N_MODELS = 1;
+    static void save(ModelWriter& out, const BasicLinearRegression<T, Acc>& model);
+    static BasicLinearRegression<T, Acc> load(const MappedModels& in, std::size_t model);
+};
+template <typename T, typename Acc>
+struct ModelSerializer<BasicLogisticRegression<T, Acc>>
+{
+    static constexpr std::size_t N_MODELS = 1;
+    static void save(ModelWriter& out, const BasicLogisticRegression<T, Acc>& model);
+    static BasicLogisticRegression<T, Acc> load(const MappedModels& in, std::size_t model);
+};
+template <typename T, typename Acc>
+struct ModelSerializer<BasicZScoreNormalizer<T, Acc>>
+{
+    static constexpr std::size_t N_MODELS = 1;
+    static void save(ModelWriter& out, const BasicZScoreNormalizer<T, Acc>& model);
+    static BasicZScoreNormalizer<T, Acc> load(const MappedModels& in, std::size_t model);
+};
+template <>
+struct ModelSerializer<PolynomialFeatures>
+{
+    static constexpr std::size_t N_MODELS = 1;
+    static void save(ModelWriter& out, const PolynomialFeatures& model);
+    static PolynomialFeatures load(const MappedModels& in, std::size_t model);
+};
+// A Pipeline is its steps, one after the other. chunk_rows is not saved.
+template <typename... Steps>
+struct ModelSerializer<Pipeline<Steps...>>
+{
+    static constexpr std::size_t N_MODELS = (ModelSerializer<Steps>::N_MODELS + ...);
+    static void save(ModelWriter& out, const Pipeline<Steps...>& pipe)
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            (ModelSerializer<Steps>::save(out, pipe.template step<I>()), ...);
+        }(std::index_sequence_for<Steps...>{});
+    }
+    static Pipeline<Steps...> load(const MappedModels& in, std::size_t model)
+    {
+        //Braced initializers are evaluated in order, so every step starts where the previous one ended
+        std::size_t next = model;
+        return Pipeline<Steps...>{ModelSerializer<Steps>::load(in, std::exchange(next, next+ModelSerializer<Steps>::N_MODELS))...};
+    }
+};
+}// namespace ML
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace ML
+{
+// Saves and loads Model, specialized in modelfile.hpp. Estimators make their specialization a friend.
+template <typename Model>
+struct ModelSerializer;
+
+// Fitted parameters of a model: either owned, as after fit, or borrowed from memory that owner keeps alive, such as the
+// mapping of a model file (see MappedModels). Reads go through the same pointer either way, so a loaded model predicts
+// straight from the mapped file.
+template <typename T>
+class ParameterArray
+{
+public:
+    ParameterArray() = default;
+    ParameterArray(std::vector<T> values):
+        owned_(std::move(values)), view_(owned_)
+    {}
+    ParameterArray(std::span<const T> values, std::shared_ptr<const void> owner):
+        view_(values), owner_(std::move(owner))
+    {}
+
+    ParameterArray(const ParameterArray& other):
+        owned_(other.owned_), view_(other.owner_? other.view_:std::span<const T>(owned_)), owner_(other.owner_)
+    {}
+    //Moving a vector keeps its buffer, so view_ stays valid
+    ParameterArray(ParameterArray&& other) noexcept:
+        owned_(std::move(other.owned_)), view_(std::exchange(other.view_, {})), owner_(std::move(other.owner_))
+    {}
+    ParameterArray& operator=(ParameterArray other) noexcept
+    {
+        owned_ = std::move(other.owned_);
+        view_ = std::exchange(other.view_, {});
+        owner_ = std::move(other.owner_);
+        return *this;
+    }
+
+    const T* data() const { return view_.data(); }
+    std::size_t size() const { return view_.size(); }
+    bool empty() const { return view_.empty(); }
+    const T& operator[](std::size_t i) const { return view_[i]; }
+    const T* begin() const { return view_.data(); }
+    const T* end() const { return view_.data()+view_.size(); }
+    operator std::span<const T>() const { return view_; }
+
+    // Whether the values live in memory owned by someone else, a mapped model file
+    bool borrowed() const { return owner_ != nullptr; }
+private:
+    std::vector<T> owned_;
+    std::span<const T> view_;
+    std::shared_ptr<const void> owner_;
+};
+}// namespace ML
@@ -0,0 +1,296 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <format>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "array2D.hpp"
+#include "mlcommons.hpp"
+#include "transformermixin.hpp"
+#include "regressormixin.hpp"
+#include "classifiermixin.hpp"
+
+namespace ML
+{
+template <typename... Steps>
+class Pipeline;
+
+namespace detail
+{
+// A pipeline ending in a regressor or a classifier is one itself, otherwise it is a transformer
+template <typename P, typename Final>
+using pipeline_base_t = std::conditional_t<is_regressor<Final>(), RegressorMixin<P>,
+    std::conditional_t<is_classifier<Final>(), ClassifierMixin<P>, TransformerMixin<P>>>;
+
+// Scalar type of the data going through a pipeline: that of its first step with a value_type, float if none has one
+template <typename... Steps>
+struct pipeline_scalar_
+{
+    using type = float;
+};
+template <typename Step, typename... Steps>
+struct pipeline_scalar_<Step, Steps...>
+{
+    using type = typename pipeline_scalar_<Steps...>::type;
+};
+template <typename Step, typename... Steps>
+requires requires { typename Step::value_type; }
+struct pipeline_scalar_<Step, Steps...>
+{
+    using type = typename Step::value_type;
+};
+}// namespace detail
+
+// Chains transformers and (optionally) a final estimator: Pipeline pipe(ZScoreNormalizer(), PolynomialFeatures(3),
+// LinearRegression()). fit fits every step on the output of the previous ones. predict and transform stream X in
+// chunks of chunk_rows rows through all the steps, each writing into a scratch buffer of one chunk that is reused for
+// every chunk, so memory is bounded by the chunk size instead of the size of X and every intermediate is still in
+// cache when the next step reads it. Steps with transform_into (and n_features_out when they change the number of
+// columns) write straight into those buffers, others go through transform and a copy. The buffers live in a Workspace
+// that is kept between calls, so repeated predictions do not allocate.
+template <typename... Steps>
+class Pipeline : public detail::pipeline_base_t<Pipeline<Steps...>, std::tuple_element_t<sizeof...(Steps)-1, std::tuple<Steps...>>>
+{
+    static_assert(sizeof...(Steps) > 0, "A Pipeline needs at least one step");
+    using Final_ = std::tuple_element_t<sizeof...(Steps)-1, std::tuple<Steps...>>;
+    static constexpr bool has_estimator_ = is_regressor<Final_>() or is_classifier<Final_>();
+    static constexpr std::size_t N_STEPS_ = sizeof...(Steps);
+    //Steps that transform chunks on the way to the final estimator (all of them without one)
+    static constexpr std::size_t N_TRANSFORMS_ = has_estimator_? N_STEPS_-1:N_STEPS_;
+public:
+    // Scalar type of X and of every intermediate, see detail::pipeline_scalar_
+    using value_type = typename detail::pipeline_scalar_<Steps...>::type;
+    static constexpr std::size_t DEFAULT_CHUNK_ROWS = 256;
+
+    // Chunk buffers of predict, predict_proba and transform: the output of every transforming step for one chunk, and
+    // the scratch of the steps with a scratch_size. They only grow. The overloads without a Workspace use one kept in
+    // the Pipeline, one call at a time; threads sharing a Pipeline each pass their own to predict concurrently.
+    class Workspace
+    {
+        friend class Pipeline;
+        std::array<Array2D<value_type>, N_TRANSFORMS_> buffers_;
+        std::array<std::vector<value_type>, N_TRANSFORMS_> scratch_;
+    };
+
+    explicit Pipeline(Steps... steps):
+        steps_(std::move(steps)...)
+    {}
+    //Rows pushed through the steps at a time by predict and transform
+    Pipeline& set_chunk_rows(std::size_t chunk_rows)
+    {
+        if (chunk_rows == 0)
+        {
+            throw std::invalid_argument("chunk_rows must be at least 1");
+        }
+        chunk_rows_ = chunk_rows;
+        return *this;
+    }
+
+    template <std::size_t I>
+    auto& step() { return std::get<I>(steps_); }
+    template <std::size_t I>
+    const auto& step() const { return std::get<I>(steps_); }
+
+    Pipeline& fit(Array2DView<const value_type> X, const auto& y) requires has_estimator_
+    {
+        Array2D<value_type> Xt = fit_transforms_(X);
+        std::get<N_STEPS_-1>(steps_).fit(N_TRANSFORMS_ == 0? X:Array2DView<const value_type>(Xt), y);
+        return *this;
+    }
+    Pipeline& fit(Array2DView<const value_type> X) requires (not has_estimator_)
+    {
+        fit_transforms_(X);
+        return *this;
+    }
+
+    auto predict(Array2DView<const value_type> X) const requires has_estimator_
+    {
+        decltype(std::get<N_STEPS_-1>(steps_).predict(X)) y_pred(X.size());
+        predict_into(X, std::span(y_pred));
+        return y_pred;
+    }
+    // Same into y_pred, which must have X.size() elements. Only the chunk buffers are allocated, on the first call.
+    template <typename T>
+    void predict_into(Array2DView<const value_type> X, std::span<T> y_pred) const requires has_estimator_
+    {
+        std::lock_guard lock(shared_.mutex);
+        predict_into(X, y_pred, shared_.workspace);
+    }
+    // Same with the chunk buffers of workspace, so threads sharing the Pipeline do not wait for each other
+    template <typename T>
+    void predict_into(Array2DView<const value_type> X, std::span<T> y_pred, Workspace& workspace) const requires has_estimator_
+    {
+        if (y_pred.size() != X.size())
+        {
+            throw std::invalid_argument(std::format("y_pred has {} elements for {} samples", y_pred.size(), X.size()));
+        }
+        stream_(X, workspace, [&](std::size_t first, Array2DView<const value_type> Xt)
+        {
+            std::get<N_STEPS_-1>(steps_).predict_into(Xt, y_pred.subspan(first, Xt.size()));
+        });
+    }
+    // One row of class probabilities per sample, in the order of classes() of the final estimator
+    auto predict_proba(Array2DView<const value_type> X) const requires requires(const Final_& f) { f.predict_proba(X); f.classes(); }
+    {
+        using Acc = typename decltype(std::get<N_STEPS_-1>(steps_).predict_proba(X))::value_type;
+        std::size_t n_classes = std::get<N_STEPS_-1>(steps_).classes().size();
+        Array2D<Acc> proba(X.size(), n_classes);
+        //The final estimator writes the classes of a chunk as rows, they are transposed into proba
+        Array2D<Acc> chunk_proba(n_classes, std::min(chunk_rows_, X.size()));
+        std::lock_guard lock(shared_.mutex);
+        stream_(X, shared_.workspace, [&](std::size_t first, Array2DView<const value_type> Xt)
+        {
+            Array2DView<Acc> classes_proba = Array2DView<Acc>(chunk_proba).cols(0, Xt.size());
+            std::get<N_STEPS_-1>(steps_).predict_proba_into(Xt, classes_proba);
+            for (std::size_t k=0; k<n_classes; k++)
+            {
+                for (std::size_t r=0; r<Xt.size(); r++)
+                {
+                    proba[first+r][k] = classes_proba[k][r];
+                }
+            }
+        });
+        return proba;
+    }
+
+    [[nodiscard]] Array2D<value_type> transform(Array2DView<const value_type> X) const requires (not has_estimator_)
+    {
+        Array2D<value_type> Xt(X.size(), widths_(X.shape().second).back());
+        std::lock_guard lock(shared_.mutex);
+        stream_(X, shared_.workspace, [&](std::size_t first, Array2DView<const value_type> chunk)
+        {
+            for (std::size_t r=0; r<chunk.size(); r++)
+            {
+                std::ranges::copy(chunk[r], std::begin(Xt[first+r]));
+            }
+        });
+        return Xt;
+    }
+private:
+    // Fits the transforming steps one after the other, each on the output of the previous one, and returns the last
+    // output. Only one intermediate is alive at a time, apart from the one being computed.
+    Array2D<value_type> fit_transforms_(Array2DView<const value_type> X)
+    {
+        Array2D<value_type> Xt;
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            [[maybe_unused]] auto fit_step = [&](auto& step, bool is_last)
+            {
+                Array2DView<const value_type> in = Xt.size() > 0? Array2DView<const value_type>(Xt):X;
+                if (is_last and not has_estimator_)
+                {
+                    step.fit(in);
+                }
+                else
+                {
+                    Xt = step.fit_transform(in);
+                }
+            };
+            (fit_step(std::get<I>(steps_), I+1 == N_TRANSFORMS_), ...);
+        }(std::make_index_sequence<N_TRANSFORMS_>{});
+        return Xt;
+    }
+
+    template <typename Step>
+    static std::size_t n_features_out_(const Step& step, std::size_t n_features_in)
+    {
+        if constexpr (requires { step.n_features_out(); })
+        {
+            return step.n_features_out();
+        }
+        else
+        {
+            return n_features_in;
+        }
+    }
+    // Columns going into every transforming step, and out of the last one
+    std::array<std::size_t, N_TRANSFORMS_+1> widths_(std::size_t n_features) const
+    {
+        std::array<std::size_t, N_TRANSFORMS_+1> widths;
+        widths[0] = n_features;
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            ((widths[I+1] = n_features_out_(std::get<I>(steps_), widths[I])), ...);
+        }(std::make_index_sequence<N_TRANSFORMS_>{});
+        return widths;
+    }
+
+    template <typename Step>
+    static void transform_into_(const Step& step, Array2DView<const value_type> in, Array2DView<value_type> out, std::vector<value_type>& scratch)
+    {
+        if constexpr (requires { step.scratch_size(); })
+        {
+            if (scratch.size() < step.scratch_size())
+            {
+                scratch.resize(step.scratch_size());
+            }
+            step.transform_into(in, out, std::span<value_type>(scratch));
+        }
+        else if constexpr (requires { step.transform_into(in, out); })
+        {
+            step.transform_into(in, out);
+        }
+        else
+        {
+            auto chunk = step.transform(in);
+            for (std::size_t r=0; r<in.size(); r++)
+            {
+                std::ranges::copy(chunk[r], std::begin(out[r]));
+            }
+        }
+    }
+
+    // Calls consume(first_row, Xt) for every chunk of rows of X, Xt being the chunk after all the transforming steps
+    template <typename Consume>
+    void stream_(Array2DView<const value_type> X, Workspace& workspace, Consume consume) const
+    {
+        auto& buffers = workspace.buffers_;
+        auto widths = widths_(X.shape().second);
+        std::size_t buffer_rows = std::min(chunk_rows_, X.size());
+        for (std::size_t k=0; k<N_TRANSFORMS_; k++)
+        {
+            if (buffers[k].size() < buffer_rows or buffers[k].shape().second != widths[k+1])
+            {
+                buffers[k] = Array2D<value_type>(std::max(buffer_rows, buffers[k].size()), widths[k+1]);
+            }
+        }
+        for (std::size_t first=0; first<X.size(); first+=chunk_rows_)
+        {
+            std::size_t last = std::min(first+chunk_rows_, X.size());
+            Array2DView<const value_type> chunk = X.rows(first, last);
+            [&]<std::size_t... I>(std::index_sequence<I...>)
+            {
+                [[maybe_unused]] auto apply = [&](const auto& step, Array2D<value_type>& buffer, std::vector<value_type>& scratch)
+                {
+                    Array2DView<value_type> out = Array2DView<value_type>(buffer).rows(0, last-first);
+                    transform_into_(step, chunk, out, scratch);
+                    chunk = out;
+                };
+                (apply(std::get<I>(steps_), buffers[I], workspace.scratch_[I]), ...);
+            }(std::make_index_sequence<N_TRANSFORMS_>{});
+            consume(first, chunk);
+        }
+    }
+
+    // Workspace of the overloads that take none. A copied Pipeline starts with an empty one.
+    struct SharedWorkspace_
+    {
+        std::mutex mutex;
+        Workspace workspace;
+
+        SharedWorkspace_() = default;
+        SharedWorkspace_(const SharedWorkspace_&) {}
+        SharedWorkspace_& operator=(const SharedWorkspace_&) { return *this; }
+    };
+
+    std::tuple<Steps...> steps_;
+    std::size_t chunk_rows_ = DEFAULT_CHUNK_ROWS;
+    mutable SharedWorkspace_ shared_;
+};
+}// namespace ML
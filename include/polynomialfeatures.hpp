@@ -4,10 +4,84 @@
 #include <array2D.hpp>
 #include <transformermixin.hpp>
 #include <utils.hpp>
+#include <combinatorics.hpp>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <threadpool.hpp>
+#include <profiling.hpp>
+#include <parameters.hpp>
 
 namespace ML
 {
+template <typename T>
+class BasicPolynomialExpansion;
+
+namespace detail
+{
+// Every column of a polynomial expansion (bias excluded) comes from a run: columns [dst, dst+length) either copy input
+// features [src, src+length) (feature == POLYNOMIAL_COPY) or multiply columns [src, src+length) by input feature
+// `feature`. Columns are numbered in output order, degree by degree.
+struct PolynomialRun
+{
+    std::uint32_t src, dst, length, feature;
+};
+inline constexpr std::uint32_t POLYNOMIAL_COPY = -1;
+
+// Degree d columns are the d-combinations of the features (with repetition unless interaction_only) in lexicographic
+// order, like in scikit-learn, and column c is x[c[0]] times the degree d-1 column of c[1:]. Since c[1:] ranks are
+// consecutive for a run of combinations starting with the same feature, those collapse into a single run.
+template <bool WithReplacement>
+constexpr void add_degree_runs_(size_t n_features, unsigned degree, std::uint32_t first_col, std::uint32_t previous_first_col, std::vector<PolynomialRun>& runs)
+{
+    BasicCombinations<WithReplacement> columns(n_features, degree), tails(n_features, degree-1);
+    for (auto it=columns.begin(); it!=columns.end(); ++it)
+    {
+        const Combination& c = *it;
+        auto dst = static_cast<std::uint32_t>(first_col + it.rank());
+        auto src = static_cast<std::uint32_t>(previous_first_col + tails.rank(std::span<const unsigned>(c).subspan(1)));
+        PolynomialRun& last = runs.back();
+        if (last.feature == c[0] and last.src+last.length == src and last.dst+last.length == dst)
+        {
+            last.length++;
+        }
+        else
+        {
+            runs.push_back({src, dst, 1, c[0]});
+        }
+    }
+}
+
+constexpr std::vector<PolynomialRun> polynomial_runs_(size_t n_features, int max_degree, bool interaction_only)
+{
+    std::vector<PolynomialRun> runs;
+    if (max_degree > 0)
+    {
+        runs.push_back({0, 0, static_cast<std::uint32_t>(n_features), POLYNOMIAL_COPY});
+    }
+    std::uint32_t previous_first_col = 0, first_col = n_features;
+    for (int d=2; d<=max_degree; d++)
+    {
+        std::size_t n_cols;
+        if (interaction_only)
+        {
+            add_degree_runs_<false>(n_features, d, first_col, previous_first_col, runs);
+            n_cols = Combinations(n_features, d).size();
+        }
+        else
+        {
+            add_degree_runs_<true>(n_features, d, first_col, previous_first_col, runs);
+            n_cols = CombinationsWithReplacement(n_features, d).size();
+        }
+        previous_first_col = first_col;
+        first_col += n_cols;
+    }
+    return runs;
+}
+}// namespace detail
+
 class PolynomialFeatures : public TransformerMixin<PolynomialFeatures>
 {
 private:
@@ -17,9 +91,54 @@ private:
     bool interaction_only_ = false;
     bool include_bias_ = false;
 
+    int n_jobs_ = DEFAULT_N_JOBS;
+    //Threads of transform, started by the first one with several blocks
+    LazyThreadPool pool_;
+
     size_t n_features_ = 0;
-    size_t n_features_out_;
-    size_t n_out_full_;
+    size_t n_features_out_ = 0;
+
+    // Output plan built by fit, see detail::PolynomialRun. Columns below skip_ (degrees under min_degree) are only needed
+    // to build higher degrees, so they live in per-thread scratch and never reach the output. Runs are split so neither
+    // their src nor their dst range straddles skip_.
+    using Run = detail::PolynomialRun;
+    static constexpr std::uint32_t COPY_ = detail::POLYNOMIAL_COPY;
+    static constexpr size_t BLOCK_ROWS = 256;
+    std::vector<Run> plan_;
+    size_t n_full_ = 0, skip_ = 0;
+
+    void build_plan_()
+    {
+        std::vector<Run> runs = detail::polynomial_runs_(n_features_, degree_.second, interaction_only_);
+        n_full_ = 0;
+        for (const Run& run: runs)
+        {
+            n_full_ += run.length;
+        }
+        skip_ = n_full_ - (n_features_out_ - include_bias_);
+
+        plan_.clear();
+        for (Run run: runs)
+        {
+            //Split points where src (for products) or dst cross skip_
+            while (run.length > 0)
+            {
+                std::uint32_t length = run.length;
+                if (run.dst < skip_)
+                {
+                    length = std::min<std::uint32_t>(length, skip_-run.dst);
+                }
+                if (run.feature != COPY_ and run.src < skip_)
+                {
+                    length = std::min<std::uint32_t>(length, skip_-run.src);
+                }
+                plan_.push_back({run.src, run.dst, length, run.feature});
+                run.src += length;
+                run.dst += length;
+                run.length -= length;
+            }
+        }
+    }
 
     static constexpr size_t combinations_(size_t n_features, const degree_type& min_degree, const degree_type& max_degree, bool interaction_only, bool include_bias)
     {
@@ -54,6 +173,7 @@ public:
     static constexpr std::pair<int, int> DEFAULT_DEGREE = {0, 2};
     static constexpr bool DEFAULT_INTERACTION_ONLY = false;
     static constexpr bool DEFAULT_INCLUDE_BIAS = true;
+    static constexpr int DEFAULT_N_JOBS = 1;
 
 
 
@@ -69,10 +189,13 @@ public:
         */
         bool interaction_only = DEFAULT_INTERACTION_ONLY;
         bool include_bias = DEFAULT_INCLUDE_BIAS;
+        int n_jobs = DEFAULT_N_JOBS; //Threads used by transform, -1 for all cores
     };
     PolynomialFeatures(ConstructorParams p):
         interaction_only_(p.interaction_only),
-        include_bias_(p.include_bias)
+        include_bias_(p.include_bias),
+        n_jobs_(p.n_jobs),
+        pool_(p.n_jobs)
     {
         std::visit([this](auto&& d)
         {
@@ -99,7 +222,7 @@ public:
         include_bias_(include_bias)
     {}
 
-    constexpr PolynomialFeatures& fit(const Array2D<float>& X)
+    constexpr PolynomialFeatures& fit(const TwoDimensionalAccesible auto& X)
     {
         n_features_ = X[0].size();
         /*n_features_out_ = binomial_coefficient(n_features_+degree_, degree_);
@@ -122,107 +245,309 @@ public:
             interaction_only_,
             include_bias_
         );
-        n_out_full_ = combinations_(
-            n_features_,
-            0,
-            max_degree,
-            interaction_only_,
-            include_bias_
-        );
+        build_plan_();
 
         return *this;
     }
-    [[nodiscard]] Array2D<float> transform(const Array2D<float>& X) const
+    // Rows are expanded in blocks of BLOCK_ROWS, spread over n_jobs threads, straight into the final output. With a
+    // row-major X every row is built in place in its output row. With a column-major X every output column of the block
+    // is the elementwise product of two contiguous column segments. The output has the scalar type of X. Every thread
+    // takes every n_jobs-th block and allocates its scratch once.
+    template <TwoDimensionalAccesible Matrix>
+    [[nodiscard]] auto transform(const Matrix& X) const
+    {
+        constexpr Layout L = Matrix::layout;
+        using T = std::remove_const_t<typename Matrix::value_type>;
+        check_fitted_(X[0].size());
+        MLPP_PROFILE_DATA_SCOPE("PolynomialFeatures::transform", X.size(), X.size()*(n_features_+n_features_out_)*sizeof(T));
+
+        size_t n_samples = X.size();
+        Array2D<T, AlignedStorage<>, L> XP(n_samples, n_features_out_);
+        size_t n_blocks = (n_samples+BLOCK_ROWS-1)/BLOCK_ROWS;
+        size_t n_tasks = std::min(pool_.size(), n_blocks);
+        pool_.parallel_for(n_tasks, [&](size_t task)
+        {
+            //A column of the lower degrees per row of the block with a column-major X, a single row otherwise
+            std::vector<T> scratch(L == Layout::column_major? skip_*BLOCK_ROWS:skip_);
+            for (size_t block=task; block<n_blocks; block+=n_tasks)
+            {
+                size_t first = block*BLOCK_ROWS, last = std::min(first+BLOCK_ROWS, n_samples);
+                if constexpr (L == Layout::column_major)
+                {
+                    expand_columns_(X, XP, first, last, scratch.data());
+                }
+                else
+                {
+                    for (size_t r=first; r<last; r++)
+                    {
+                        expand_row_(X[r].data(), XP[r].data(), scratch.data());
+                    }
+                }
+            }
+        });
+        return XP;
+    }
+    //Writes transform(X) into out, which must have X.size() rows and n_features_out() columns. The columns of degree
+    //below min_degree are built in scratch, which needs scratch_size() elements.
+    template <typename T>
+    void transform_into(Array2DView<const std::type_identity_t<T>> X, Array2DView<T> out, std::span<T> scratch) const
+    {
+        check_fitted_(X.shape().second);
+        if (out.shape() != std::pair(X.size(), n_features_out_))
+        {
+            throw std::invalid_argument(std::format("out has shape ({}, {}), transform_into needs ({}, {})", out.shape().first, out.shape().second, X.size(), n_features_out_));
+        }
+        if (scratch.size() < skip_)
+        {
+            throw std::invalid_argument(std::format("scratch has {} elements, transform_into needs {}", scratch.size(), skip_));
+        }
+        MLPP_PROFILE_DATA_SCOPE("PolynomialFeatures::transform_into", X.size(), X.size()*(n_features_+n_features_out_)*sizeof(T));
+        for (size_t r=0; r<X.size(); r++)
+        {
+            expand_row_(X[r].data(), out[r].data(), scratch.data());
+        }
+    }
+    //Same with its own scratch, which is only allocated when min_degree >= 2
+    template <typename T>
+    void transform_into(Array2DView<const std::type_identity_t<T>> X, Array2DView<T> out) const
+    {
+        std::vector<T> scratch(skip_);
+        transform_into<T>(X, out, scratch);
+    }
+    size_t n_features_out() const { return n_features_out_; }
+    size_t scratch_size() const { return skip_; }
+    // Lazy transform(X) for the linear models, see BasicPolynomialExpansion
+    template <typename Matrix>
+    [[nodiscard]] BasicPolynomialExpansion<typename Matrix::value_type> expand(const Matrix& X) const;
+    //void fit_transform(Array2D<float>& X);
+private:
+    template <typename T>
+    friend class BasicPolynomialExpansion;
+    friend struct ModelSerializer<PolynomialFeatures>;
+
+    void check_fitted_(size_t n_features) const
     {
-        namespace ranges = std::ranges;
         if (n_features_ == 0)
         {
             throw std::logic_error("Estimator is not fitted or fit data was empty");
         }
+        if (n_features != n_features_)
+        {
+            throw std::invalid_argument(std::format("X has {} features, but PolynomialFeatures was fitted with {}", n_features, n_features_));
+        }
+    }
 
-        auto [min_degree, max_degree] = degree_;
-
-        size_t n_samples = X.size(), n_features = X[0].size();
-        Array2D<float> XP(n_samples, n_out_full_);
-        size_t current_col = 0;
+    template <typename T>
+    void expand_row_(const T* x, T* out, T* scratch) const
+    {
         if (include_bias_)
         {
-            ranges::fill(XP[][0], 1);
-            current_col = 1;
+            *out++ = 1;
         }
-
-        if (max_degree == 0)
+        auto col = [=, this](size_t t) { return t < skip_? scratch+t:out+(t-skip_); };
+        for (const Run& run: plan_)
         {
-            return XP;
+            T* dst = col(run.dst);
+            if (run.feature == COPY_)
+            {
+                std::copy_n(x+run.src, run.length, dst);
+            }
+            else
+            {
+                const T* src = col(run.src);
+                T x_f = x[run.feature];
+                for (size_t k=0; k<run.length; k++)
+                {
+                    dst[k] = src[k]*x_f;
+                }
+            }
         }
+    }
 
-        for (auto&& [row, og_row]: std::views::zip(XP, X))
+    // Rows [first, last) of XP, scratch holds skip_ columns of last-first rows
+    template <typename Matrix, typename Out>
+    void expand_columns_(const Matrix& X, Out& XP, size_t first, size_t last, typename Out::value_type* scratch) const
+    {
+        using T = typename Out::value_type;
+        size_t rows = last-first;
+        if (include_bias_)
         {
-            //ranges::copy(og_row, row | std::views::drop(current_col));
-            std::copy(std::begin(og_row), std::end(og_row), std::begin(row)+current_col);
+            std::fill_n(XP[][0].data()+first, rows, T(1));
         }
-
-        std::vector<size_t> index(n_features+1);
-        ranges::iota(index, current_col);
-        current_col += n_features;
-        std::vector<size_t> new_index;
-        new_index.reserve(n_features+1);
-        for (int i=2; i<=max_degree; i++)
+        auto col = [&](size_t t) { return t < skip_? scratch+t*rows:XP[][include_bias_+t-skip_].data()+first; };
+        for (const Run& run: plan_)
         {
-            size_t end = index.back();
-            for (size_t feature_idx=0; feature_idx<n_features; feature_idx++)
+            for (size_t k=0; k<run.length; k++)
             {
-                size_t start = index[feature_idx];
-                new_index.push_back(current_col);
-                if (interaction_only_)
+                T* dst = col(run.dst+k);
+                if (run.feature == COPY_)
                 {
-                    start += index[feature_idx+1] - index[feature_idx];
+                    std::copy_n(X[][run.src+k].data()+first, rows, dst);
                 }
-                size_t next_col = current_col + end - start;
-                if (next_col <= current_col)
+                else
                 {
-                    break;
+                    const T* src = col(run.src+k);
+                    const T* x_f = X[][run.feature].data()+first;
+                    for (size_t i=0; i<rows; i++)
+                    {
+                        dst[i] = src[i]*x_f[i];
+                    }
                 }
+            }
+        }
+    }
+};
 
-                auto next_feature = X[][feature_idx];
-                for (auto&& [row, feature_row]: std::views::zip(XP, next_feature))
-                {
-                    auto row_begin = std::begin(row);                    
-                    std::transform(row_begin+start, row_begin+end, row_begin+current_col, [feature_row](float a) { return a*feature_row; });
-                }
+// The polynomial features of X without materializing them: only X and the fitted PolynomialFeatures are kept (both
+// must outlive it), and every row is expanded when it is read, each degree from the products of the previous one. Fed
+// to LinearRegression or LogisticRegression it trains on transform(X) with O(n_samples*n_features) memory instead of
+// O(n_samples*n_features_out), at the price of redoing the products every pass.
+template <typename T>
+class BasicPolynomialExpansion
+{
+public:
+    using value_type = T;
 
-                current_col = next_col;
-            }
-            new_index.push_back(current_col);
-            // No copies, equivalent to auto v_t(std::move(new_index)); new_index = std::move(index); index = std::move(v_t);
-            std::swap(index, new_index);
-            new_index.clear();
+    BasicPolynomialExpansion(const PolynomialFeatures& poly, Array2DView<const T> X):
+        poly_(&poly), X_(X)
+    {}
+
+    std::size_t size() const { return X_.size(); }
+    std::pair<std::size_t, std::size_t> shape() const { return {X_.size(), poly_->n_features_out_}; }
+    // Elements of buffer that row needs
+    std::size_t buffer_size() const { return poly_->n_features_out_ + poly_->skip_; }
+
+    // Row i of transform(X), built in buffer. Points into buffer, so it is overwritten by the next call with it
+    std::span<const T> row(std::size_t i, std::span<T> buffer) const
+    {
+        assert(buffer.size() >= buffer_size());
+        T* out = buffer.data();
+        poly_->expand_row_(X_[i].data(), out, out+poly_->n_features_out_);
+        return {out, poly_->n_features_out_};
+    }
+private:
+    const PolynomialFeatures* poly_;
+    Array2DView<const T> X_;
+};
+using PolynomialExpansion = BasicPolynomialExpansion<float>;
+
+template <typename Matrix>
+BasicPolynomialExpansion<typename Matrix::value_type> PolynomialFeatures::expand(const Matrix& X) const
+{
+    check_fitted_(X.shape().second);
+    return BasicPolynomialExpansion<typename Matrix::value_type>(*this, X);
+}
+
+// PolynomialFeatures with the number of features and all the options fixed at compile time, for scoring single samples
+// with no setup. The monomial table is built by the same recurrence as the runtime class (so columns come out in the
+// same order) during compilation, and transform_row unrolls into one multiplication per output column. Samples are
+// stored as T.
+template <std::size_t NFeatures, int MinDegree, int MaxDegree, bool InteractionOnly = PolynomialFeatures::DEFAULT_INTERACTION_ONLY, bool IncludeBias = PolynomialFeatures::DEFAULT_INCLUDE_BIAS, typename T = float>
+class StaticPolynomialFeatures : public TransformerMixin<StaticPolynomialFeatures<NFeatures, MinDegree, MaxDegree, InteractionOnly, IncludeBias, T>>
+{
+    static_assert(NFeatures > 0, "StaticPolynomialFeatures needs at least one feature");
+    static_assert(MinDegree >= 0 and MinDegree <= MaxDegree, "Invalid degree: degrees should be positive and MinDegree <= MaxDegree");
+    static_assert(MaxDegree > 0 or IncludeBias, "Setting both MinDegree and MaxDegree to zero and IncludeBias to false would result in an empty output array");
+
+    //Column t (bias excluded) is x[feature] when src is POLYNOMIAL_COPY and column src times x[feature] otherwise
+    struct Monomial
+    {
+        std::uint32_t src, feature, degree;
+    };
+    static constexpr std::size_t N_FULL_ = []
+    {
+        std::size_t n = 0;
+        for (auto run: detail::polynomial_runs_(NFeatures, MaxDegree, InteractionOnly))
+        {
+            n += run.length;
         }
-        if (min_degree > 1)
+        return n;
+    }();
+    static constexpr std::array<Monomial, N_FULL_> TABLE_ = []
+    {
+        std::array<Monomial, N_FULL_> table{};
+        for (auto run: detail::polynomial_runs_(NFeatures, MaxDegree, InteractionOnly))
         {
-            size_t n_XP = n_out_full_, n_Xout = n_features_out_;
-            Array2D<float> Xout(n_samples, n_Xout);
-            if (include_bias_)
-            {
-                ranges::fill(Xout[][0], 1);
-                
-                for (auto&& [row, row_out]: std::views::zip(XP, Xout))
-                {
-                    std::copy(std::begin(row)+n_XP - n_Xout + 1, std::end(row), std::begin(row_out)+1);
-                }
-            }
-            else
+            for (std::uint32_t k=0; k<run.length; k++)
             {
-                for (auto&& [row, row_out]: std::views::zip(XP, Xout))
-                {
-                    std::copy(std::begin(row)+n_XP - n_Xout, std::end(row), std::begin(row_out));
-                }
+                bool copy = run.feature == detail::POLYNOMIAL_COPY;
+                table[run.dst+k] = copy? Monomial{detail::POLYNOMIAL_COPY, run.src+k, 1}:Monomial{run.src+k, run.feature, table[run.src+k].degree+1};
             }
-            XP = std::move(Xout);
         }
-        return XP;
+        return table;
+    }();
+    //Columns of degree below MinDegree, only used to build the higher ones
+    static constexpr std::size_t SKIP_ = []
+    {
+        std::size_t n = 0;
+        for (const Monomial& m: TABLE_)
+        {
+            n += m.degree < static_cast<std::uint32_t>(MinDegree);
+        }
+        return n;
+    }();
+
+    template <std::size_t I>
+    static constexpr T column_(std::span<const T, NFeatures> x, const std::array<T, N_FULL_>& full)
+    {
+        constexpr Monomial m = TABLE_[I];
+        if constexpr (m.src == detail::POLYNOMIAL_COPY)
+        {
+            return x[m.feature];
+        }
+        else
+        {
+            return full[m.src]*x[m.feature];
+        }
     }
-    //void fit_transform(Array2D<float>& X);
+public:
+    using value_type = T;
+    static constexpr std::size_t n_features_in = NFeatures;
+    static constexpr std::size_t n_features_out = IncludeBias + N_FULL_ - SKIP_;
 
+    static constexpr void transform_row(std::span<const T, NFeatures> x, std::span<T, n_features_out> out)
+    {
+        std::array<T, N_FULL_> full{};
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            ((full[I] = column_<I>(x, full)), ...);
+        }(std::make_index_sequence<N_FULL_>{});
+        if constexpr (IncludeBias)
+        {
+            out[0] = T(1);
+        }
+        std::copy(std::begin(full)+SKIP_, std::end(full), std::begin(out)+IncludeBias);
+    }
+    [[nodiscard]] static constexpr std::array<T, n_features_out> transform_row(std::span<const T, NFeatures> x)
+    {
+        std::array<T, n_features_out> out;
+        transform_row(x, out);
+        return out;
+    }
+
+    // Nothing to learn, only checks the number of features
+    StaticPolynomialFeatures& fit(Array2DView<const T> X)
+    {
+        check_features_(X);
+        return *this;
+    }
+    [[nodiscard]] Array2D<T> transform(Array2DView<const T> X) const
+    {
+        check_features_(X);
+        Array2D<T> XP(X.size(), n_features_out);
+        for (std::size_t i=0; i<X.size(); i++)
+        {
+            transform_row(std::span<const T, NFeatures>(X[i].data(), NFeatures), std::span<T, n_features_out>(XP[i].data(), n_features_out));
+        }
+        return XP;
+    }
+private:
+    static void check_features_(Array2DView<const T> X)
+    {
+        if (X.shape().second != NFeatures)
+        {
+            throw std::invalid_argument(std::format("X has {} features, but StaticPolynomialFeatures expects {}", X.shape().second, NFeatures));
+        }
+    }
 };
 } // NAMESPACE ML
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Instrumentation of the hot paths (fit, transform, the solvers), compiled in only with MLPP_ENABLE_PROFILING defined
+// (the MLPP_ENABLE_PROFILING CMake option). Without it every MLPP_PROFILE_* macro expands to nothing, so the
+// instrumented code is exactly the uninstrumented one. With it, nothing is recorded until profiling::start(): until
+// then a scope costs one relaxed atomic load. Recording appends to a per-thread buffer, and only coarse operations
+// (whole calls and solver iterations, never rows) are instrumented, so the overhead stays well under a percent.
+//
+//     profiling::start();
+//     lr.fit(X, y);
+//     profiling::stop();
+//     profiling::write_chrome_trace("fit.json"); //Open in chrome://tracing or https://ui.perfetto.dev
+#ifdef MLPP_ENABLE_PROFILING
+#define MLPP_PROFILE_CONCAT_IMPL_(a, b) a##b
+#define MLPP_PROFILE_CONCAT_(a, b) MLPP_PROFILE_CONCAT_IMPL_(a, b)
+// Times the enclosing block as an event called name, a string that outlives the recording (a literal)
+#define MLPP_PROFILE_SCOPE(name) ::ML::profiling::ScopedTimer MLPP_PROFILE_CONCAT_(mlpp_profile_scope_, __LINE__)(name)
+// Same, for a block that processes rows rows and touches bytes bytes, shown as arguments of the event. There can be
+// one of these per block, MLPP_PROFILE_ADD adds to its counts.
+#define MLPP_PROFILE_DATA_SCOPE(name, rows, bytes) ::ML::profiling::ScopedTimer mlpp_profile_data_scope_(name, rows, bytes)
+#define MLPP_PROFILE_ADD(rows, bytes) mlpp_profile_data_scope_.add(rows, bytes)
+// Reports a solver iteration, a profiling::IterationInfo initializer
+#define MLPP_PROFILE_ITERATION(...) ::ML::profiling::iteration(::ML::profiling::IterationInfo __VA_ARGS__)
+#else
+#define MLPP_PROFILE_SCOPE(name) static_cast<void>(0)
+#define MLPP_PROFILE_DATA_SCOPE(name, rows, bytes) static_cast<void>(0)
+#define MLPP_PROFILE_ADD(rows, bytes) static_cast<void>(0)
+#define MLPP_PROFILE_ITERATION(...) static_cast<void>(0)
+#endif
+
+namespace ML::profiling
+{
+struct IterationInfo
+{
+    const char* solver;
+    std::size_t iteration; //0-based
+    float gradient_norm; //Largest absolute component of the gradient, the one StoppingCriterion::gradient_norm uses
+    float loss; //Training loss at the start of the iteration, NaN when the solver did not compute it
+};
+
+// Totals per event name over everything recorded since start()
+struct Summary
+{
+    std::string name;
+    std::size_t calls = 0;
+    double seconds = 0;
+    std::uint64_t rows = 0, bytes = 0;
+    std::uint64_t allocations = 0; //Heap allocations made by the calling thread inside the scope, see detail::thread_allocations
+    std::size_t iterations = 0; //Solvers only
+};
+
+// Clears what was recorded before and starts recording
+void start();
+void stop();
+// Events of every thread, in Chrome's trace event format: scopes as complete events with their rows, bytes and
+// allocations, iterations as counter tracks of the loss and gradient norm, and the summary under otherData. Throws
+// std::runtime_error if the file can not be written.
+void write_chrome_trace(const std::string& path);
+std::vector<Summary> summary();
+
+// Called on every solver iteration while set, whether or not recording is on. It runs on the thread doing the fit, and
+// can be replaced or cleared (with an empty function) while fits are running.
+void set_iteration_callback(std::function<void(const IterationInfo&)> callback);
+void iteration(const IterationInfo& info);
+
+namespace detail
+{
+inline std::atomic<bool> recording{false};
+
+inline std::uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+// Heap allocations made so far by this thread. They are only counted in executables that link the opt-in
+// MLPP_allocation_counter target (src/allocationcounter.cpp), whose operator new calls count_allocation; elsewhere the
+// global operator new is left alone and the allocations of every scope are 0.
+std::uint64_t thread_allocations();
+void count_allocation();
+void record_scope(const char* name, std::uint64_t start_ns, std::uint64_t end_ns, std::uint64_t rows, std::uint64_t bytes, std::uint64_t allocations);
+}// namespace detail
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char* name, std::uint64_t rows = 0, std::uint64_t bytes = 0):
+        name_(name), rows_(rows), bytes_(bytes), active_(detail::recording.load(std::memory_order_relaxed))
+    {
+        if (active_)
+        {
+            allocations_ = detail::thread_allocations();
+            start_ns_ = detail::now_ns();
+        }
+    }
+    ~ScopedTimer()
+    {
+        if (active_)
+        {
+            std::uint64_t end_ns = detail::now_ns();
+            detail::record_scope(name_, start_ns_, end_ns, rows_, bytes_, detail::thread_allocations()-allocations_);
+        }
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    void add(std::uint64_t rows, std::uint64_t bytes)
+    {
+        rows_ += rows;
+        bytes_ += bytes;
+    }
+private:
+    const char* name_;
+    std::uint64_t rows_, bytes_;
+    std::uint64_t start_ns_ = 0, allocations_ = 0;
+    bool active_;
+};
+}// namespace ML::profiling
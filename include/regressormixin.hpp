@@ -12,10 +12,19 @@ public:
     constexpr static EstimatorType estimator_type = EstimatorType::regressor;
     constexpr static bool requires_y = true;
     
-    float score(const Array2D<float>& X, const std::vector<float>& y)
+    //X is anything predict takes, an Array2DView or a PolynomialExpansion. Predictions are folded into the residual sum
+    //of squares as they are made instead of being collected, in the accumulator type of y and the predictions.
+    template <SampleMatrix Matrix, typename T>
+    auto score(const Matrix& X, const std::vector<T>& y) const
     {
-        std::vector<float> y_pred = this->underlying().predict(X);
-        return r2_score(y, y_pred);
+        using S = accumulator_t<std::common_type_t<T, detail::prediction_t<D, Matrix>>>;
+        S residual_sum_of_squares = 0;
+        detail::for_each_prediction_(this->underlying(), X, [&](size_t i, S y_pred)
+        {
+            S diff = static_cast<S>(y[i])-y_pred;
+            residual_sum_of_squares += diff*diff;
+        });
+        return r2_score(y, residual_sum_of_squares);
     }
 };
 
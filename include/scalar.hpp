@@ -0,0 +1,37 @@
+#pragma once
+#include <type_traits>
+#if __has_include(<stdfloat>)
+#include <stdfloat>
+#endif
+
+namespace ML
+{
+// Half precision, a storage format for data and fitted parameters where memory bandwidth is what limits inference.
+// Arithmetic on it always goes through its accumulator type.
+#if defined(__STDCPP_FLOAT16_T__)
+#define MLPP_HAS_FLOAT16 1
+using float16 = std::float16_t;
+#elif defined(__FLT16_MAX__)
+#define MLPP_HAS_FLOAT16 1
+using float16 = _Float16;
+#endif
+
+// Estimators and kernels are templates on the scalar type T their data and fitted parameters are stored in, and the
+// type Acc dot products, gradients and solver state are computed in. By default Acc is T widened to at least float:
+// half precision data is accumulated in float, double data in double.
+template <typename T>
+using accumulator_t = std::conditional_t<(sizeof(T) < sizeof(float)), float, T>;
+
+// Calls MACRO(T, Acc) for every pair the compiled kernels are instantiated for: float, double, float data trained in
+// double and, where the compiler has it, float16 accumulated in float.
+#ifdef MLPP_HAS_FLOAT16
+#define MLPP_FOR_EACH_SCALAR(MACRO) MACRO(float, float) MACRO(double, double) MACRO(float, double) MACRO(float16, float)
+#else
+#define MLPP_FOR_EACH_SCALAR(MACRO) MACRO(float, float) MACRO(double, double) MACRO(float, double)
+#endif
+
+// Calls MACRO(Matrix, ...) for the parameter type of every sample matrix the compiled kernels take, in terms of the
+// sample type T in scope: dense rows and the rows of a BasicPolynomialExpansion, expanded as they are read.
+#define MLPP_FOR_EACH_SAMPLE_MATRIX(MACRO, ...) \
+    MACRO(Array2DView<const T>, __VA_ARGS__) MACRO(const BasicPolynomialExpansion<T>&, __VA_ARGS__)
+}// namespace ML
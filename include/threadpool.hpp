@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <type_traits>
+
+namespace ML
+{
+// Number of threads to use for a given n_jobs: positive values are taken as is, negative ones count back from the
+// number of cores (-1 uses all of them, -2 all but one...), as in scikit-learn.
+size_t effective_n_jobs(int n_jobs);
+
+// Fixed set of worker threads kept alive between calls, so that an iterative solver can dispatch work every iteration
+// without creating threads or allocating. The calling thread takes part in the work. A pool runs one parallel_for at a
+// time, so it can be shared: concurrent callers wait for the running one to finish.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t n_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const
+    {
+        return workers_.size()+1;
+    }
+
+    // Calls f(i) for every i in [0, n_tasks) and returns once all calls have finished. Tasks are handed out
+    // dynamically, so f must not depend on which thread runs it.
+    template <typename F>
+    void parallel_for(size_t n_tasks, F&& f)
+    {
+        using Fn = std::remove_reference_t<F>;
+        if (workers_.empty() or n_tasks <= 1)
+        {
+            for (size_t i=0; i<n_tasks; i++)
+            {
+                f(i);
+            }
+            return;
+        }
+        run_(n_tasks, const_cast<void*>(static_cast<const void*>(std::addressof(f))), [](void* ctx, size_t i) { (*static_cast<Fn*>(ctx))(i); });
+    }
+private:
+    using Task = void (*)(void*, size_t);
+
+    void run_(size_t n_tasks, void* ctx, Task task);
+    void work_();
+    void worker_loop_();
+
+    std::vector<std::jthread> workers_;
+    std::mutex run_mutex_, mutex_;
+    std::condition_variable start_cv_, done_cv_;
+    size_t generation_ = 0;
+    size_t busy_ = 0;
+    bool stop_ = false;
+
+    void* ctx_ = nullptr;
+    Task task_ = nullptr;
+    size_t n_tasks_ = 0;
+    std::atomic<size_t> next_task_ = 0;
+};
+
+// The ThreadPool of an object with n_jobs threads, only started by the first parallel_for that has more than one task,
+// so objects that never get work large enough to split do not keep idle threads. Copies share the pool. With a single
+// thread there is no pool and every parallel_for runs on the calling thread.
+class LazyThreadPool
+{
+public:
+    LazyThreadPool() = default;
+    explicit LazyThreadPool(int n_jobs);
+
+    size_t size() const
+    {
+        return state_ == nullptr? 1:state_->n_threads;
+    }
+
+    template <typename F>
+    void parallel_for(size_t n_tasks, F&& f) const
+    {
+        if (state_ == nullptr or n_tasks <= 1)
+        {
+            for (size_t i=0; i<n_tasks; i++)
+            {
+                f(i);
+            }
+            return;
+        }
+        pool_().parallel_for(n_tasks, std::forward<F>(f));
+    }
+private:
+    struct State_
+    {
+        size_t n_threads;
+        std::once_flag started;
+        std::unique_ptr<ThreadPool> pool;
+    };
+    ThreadPool& pool_() const;
+
+    std::shared_ptr<State_> state_;
+};
+}// namespace ML
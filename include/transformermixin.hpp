@@ -1,16 +1,41 @@
 #pragma once
 #include "array2D.hpp"
 #include "crtp.hpp"
+#include <type_traits>
 namespace ML
 {
 template <typename D>
 class TransformerMixin: public CRTP<D, TransformerMixin>
 {
 public:
-    [[nodiscard]] Array2D<float> fit_transform(const Array2D<float>& X)
+    template <typename Matrix>
+    [[nodiscard]] auto fit_transform(const Matrix& X)
     {
         this->underlying().fit(X);
         return this->underlying().transform(X);
     }
+    //X is a temporary, so the transformer can reuse its buffer: X = norm.fit_transform(std::move(X)) keeps one copy
+    template <typename Matrix>
+    requires (not std::is_lvalue_reference_v<Matrix>)
+    [[nodiscard]] auto fit_transform(Matrix&& X)
+    {
+        this->underlying().fit(X);
+        return this->underlying().transform(std::move(X));
+    }
+
+    //Transformers that keep the shape override this to write over X. This fallback (owning arrays only) replaces X
+    //with its transform, for transformers that change the number of columns.
+    template <typename Matrix>
+    void transform_inplace(Matrix& X) const
+    {
+        X = this->underlying().transform(std::move(X));
+    }
+    template <typename Matrix>
+    D& fit_transform_inplace(Matrix& X)
+    {
+        this->underlying().fit(X);
+        this->underlying().transform_inplace(X);
+        return this->underlying();
+    }
 };
 } //namespace ML
\ No newline at end of file
@@ -5,7 +5,7 @@
 #include <numeric>
 #include <vector>
 
-#include <generator.hpp>
+#include <combinatorics.hpp>
 namespace ML
 {
 namespace ranges = std::ranges;
@@ -34,41 +34,11 @@ concept GradSigCallable = Callable<F, std::pair<std::vector<float>, float>(const
 template <typename F>
 concept GradSigCallableSTD = std::regular_invocable<F, std::pair<std::vector<float>, float>(const Vector2D<float>&, const std::vector<float>&, const std::vector<float>&, float)>;
 
-float dot_product(const ranges::range auto& a, const ranges::range auto& b)
+// Accumulated in Acc, whatever the element types of a and b
+template <typename Acc = float>
+Acc dot_product(const ranges::range auto& a, const ranges::range auto& b)
 {
-    return std::inner_product(std::begin(a), std::end(a), std::begin(b), 0.f);
-}
-
-
-constexpr auto binomial_coefficient(std::integral auto n, std::integral auto k) {
-    using type = decltype(k);
-    std::vector<type> aSolutions(k);
-    aSolutions[0] = n - k + 1;
-
-    for (type i = 1; i < k; ++i) {
-    aSolutions[i] = aSolutions[i - 1] * (n - k + 1 + i) / (i + 1);
-    }
-
-    return aSolutions[k - 1];
-}
-template <std::ranges::random_access_range I>
-coro::generator<coro::generator<unsigned>> combinations_with_replacement(I iterable, unsigned r)
-{
-    namespace ranges = std::ranges;
-    size_t n = iterable.size();
-    if (not n and r) co_return;
-    std::vector indices(r, 0u);
-    auto gen_in = [&iterable, &indices]() -> coro::generator<unsigned> { for (unsigned i: indices) co_yield iterable[i]; };
-    co_yield gen_in();
-    for(;;)
-    {
-        unsigned i;
-        for (i=r-1; i!=(unsigned)-1 and indices[i] == n - 1; i--) { }
-        if (i==(unsigned)-1) co_return;
-        std::fill(std::begin(indices)+i, std::end(indices), indices[i] + 1);
-        //std::fill_n(std::begin(indices)+i, r-i, indices[i]+1);
-        co_yield gen_in();
-    }
+    return std::inner_product(std::begin(a), std::end(a), std::begin(b), Acc(0));
 }
 
 
@@ -110,48 +80,6 @@ void print(Printable auto&& v, char delimiter = '\n')
     std::cout << v << delimiter;
 }
 
-template <std::ranges::random_access_range I>
-coro::generator<coro::generator<unsigned>> combinations(I iterable, unsigned r)
-{
-    namespace ranges = std::ranges;
-    size_t n = iterable.size();
-
-    if (r > n) co_return;
-
-    std::vector<unsigned> indices(r);
-    ranges::iota(indices, 0);
-
-    /*std::vector<unsigned> result_(r);
-    [[maybe_unused]] auto modify = [&] { 
-        for (size_t i=0; i<r; i++) 
-            result_[i] = iterable[indices[i]]; 
-    };
-    modify();
-    co_yield result_;
-    */
-    auto gen_in = [&iterable, &indices]() -> coro::generator<unsigned> { for (unsigned i: indices) co_yield iterable[i]; };
-    co_yield gen_in();
-    for(;;)
-    {
-        unsigned i;
-        /*bool none = ranges::none_of(std::views::iota(0u, r) | std::views::reverse, [&] (unsigned inx)
-        {
-            i = inx;
-            return indices[i] != i + n - r;
-        });
-        if none co_return;*/
-        
-        for (i=r-1; i!=(unsigned)-1 and indices[i] == i + n - r; i--) { }
-        if (i==(unsigned)-1) co_return;
-
-        indices[i] += 1;
-        for (auto j: std::ranges::iota_view(i+1, r))
-        {
-            indices[j] = indices[j-1] + 1;
-        }
-        co_yield gen_in();
-    }
-}
 //template <typename F>
 //concept GradSigCallable = requires(F f, const std::vector<float>& X, const std::vector<float>& y, float w, float b) { f(X, y, w, b); };
 }
\ No newline at end of file
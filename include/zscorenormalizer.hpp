@@ -3,32 +3,83 @@
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <span>
 
 #include <array2D.hpp>
 #include <utils.hpp>
 #include <transformermixin.hpp>
+#include <parameters.hpp>
+#include <scalar.hpp>
+#include <threadpool.hpp>
 
 namespace ML
 {
-class ZScoreNormalizer: public TransformerMixin<ZScoreNormalizer>
+// Standardizes every feature to zero mean and unit (population) variance. The statistics are accumulated in a single
+// pass over the rows with Welford's update, in fixed-size row shards run in parallel and merged in order with Chan et
+// al.'s formula, so the result does not depend on n_jobs. partial_fit keeps merging new chunks into the same running
+// statistics, for data that does not fit in memory at once. Transforms data stored as T, computing in Acc.
+template <typename T, typename Acc = accumulator_t<T>>
+class BasicZScoreNormalizer: public TransformerMixin<BasicZScoreNormalizer<T, Acc>>
 {
+public:
+    using value_type = T;
+    static constexpr int DEFAULT_N_JOBS = 1;
+    static constexpr size_t SHARD_ROWS = 4096;
 private:
-    struct Statistics
+    friend struct ModelSerializer<BasicZScoreNormalizer>;
+
+    //x*scale + shift for every feature: (x-mean)/stddev going forward and x*stddev + mean going back
+    struct Affine
     {
-        float mean=0, stddev=0;
+        std::vector<Acc> scale, shift;
     };
-    std::vector<Statistics> stats_;
+    //Running mean and sum of squared deviations of one feature, in double so long streams do not drift
+    struct Moments
+    {
+        double mean=0, m2=0;
+    };
+    Affine forward_, inverse_;
+    std::vector<Moments> moments_;
+    size_t n_samples_seen_ = 0;
+    int n_jobs_ = DEFAULT_N_JOBS;
+    //Threads of partial_fit, started by the first one with several shards (or features)
+    LazyThreadPool pool_;
 
-    constexpr float norm_sample(float value, size_t feature) const;
-    constexpr float inv_norm_sample(float norm_value, size_t feature) const;
+    //Throws unless f is fitted, in has its number of features and out the shape of in
+    static void check_shapes_(const Affine& f, std::pair<size_t, size_t> in, std::pair<size_t, size_t> out);
+    //The kernel shared by transform and inverse_transform, in may be the same memory as out
+    void apply_(const Affine& f, Array2DView<const T> in, Array2DView<T> out) const;
+    void apply_(const Affine& f, const ColumnMajorArray2D<T>& in, ColumnMajorArray2D<T>& out) const;
 
-    constexpr void update_feature_stats(const Array2D<float>& X, size_t feature);
+    //Forgets the samples seen so far, the normalizer is not fitted any more
+    void reset_();
+    void check_features_(size_t n_features);
+    //Merges the moments of n_b samples into moments_, which holds those of n_samples_seen_
+    void merge_moments_(std::span<const Moments> b, size_t n_b);
+    void update_stats_();
 public:
-    ZScoreNormalizer() = default;
+    BasicZScoreNormalizer() = default;
+    explicit BasicZScoreNormalizer(int n_jobs);
+
+    //Starts over from the samples of X, with no samples it is left unfitted
+    BasicZScoreNormalizer& fit(Array2DView<const T> X);
+    BasicZScoreNormalizer& fit(const ColumnMajorArray2D<T>& X);
+    BasicZScoreNormalizer& partial_fit(Array2DView<const T> X);
+    BasicZScoreNormalizer& partial_fit(const ColumnMajorArray2D<T>& X);
+    [[nodiscard]] Array2D<T> transform(Array2DView<const T> X) const;
+    [[nodiscard]] ColumnMajorArray2D<T> transform(const ColumnMajorArray2D<T>& X) const;
+    //Reuse the buffer of X for the result
+    [[nodiscard]] Array2D<T> transform(Array2D<T>&& X) const;
+    [[nodiscard]] ColumnMajorArray2D<T> transform(ColumnMajorArray2D<T>&& X) const;
+    void transform_inplace(Array2DView<T> X) const;
+    void transform_inplace(ColumnMajorArray2D<T>& X) const;
+    //Writes the transform of X into out (same shape), for callers that own the output buffer such as Pipeline
+    void transform_into(Array2DView<const T> X, Array2DView<T> out) const;
 
-    ZScoreNormalizer& fit(const Array2D<float>& X);
-    [[nodiscard]] Array2D<float> transform(const Array2D<float>& X_) const;
+    void inverse_transform(Array2DView<T> X) const;
+    void inverse_transform(ColumnMajorArray2D<T>& X) const;
 
-    void inverse_transform(Array2D<float>& X) const;
+    size_t n_samples_seen() const { return n_samples_seen_; }
 };
+using ZScoreNormalizer = BasicZScoreNormalizer<float>;
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include <profiling.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replacement allocation functions that count allocations per thread for the profiler. This file is not part of the
+// MLPP library: replacing operator new is the choice of the executable, which makes it by linking the
+// MLPP_allocation_counter target. The array and nothrow forms call these.
+#if defined(__GNUC__) and not defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" //GCC takes free() in a replacement operator delete for a mismatch
+#endif
+void* operator new(std::size_t size)
+{
+    ML::profiling::detail::count_allocation();
+    if (void* p = std::malloc(size == 0? 1:size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    ML::profiling::detail::count_allocation();
+    std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    void* p = _aligned_malloc(size == 0? 1:size, align);
+#else
+    //aligned_alloc needs a multiple of the alignment
+    void* p = std::aligned_alloc(align, (std::max<std::size_t>(size, 1)+align-1)/align*align);
+#endif
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
@@ -0,0 +1,260 @@
+#include <csv.hpp>
+#include <mappedfile.hpp>
+#include <threadpool.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <span>
+
+namespace ML
+{
+/**********
+* PRIVATE *
+**********/
+namespace
+{
+constexpr size_t CHUNK_BYTES = 1 << 22;
+
+// [first, last) of the next line, without the '\n' nor a trailing '\r', and the start of the line after it
+struct Line
+{
+    const char* first;
+    const char* last;
+    const char* next;
+};
+Line next_line_(const char* first, const char* end)
+{
+    auto newline = static_cast<const char*>(std::memchr(first, '\n', end-first));
+    const char* last = newline == nullptr? end:newline;
+    const char* next = newline == nullptr? end:newline+1;
+    if (last > first and last[-1] == '\r')
+    {
+        last--;
+    }
+    return {first, last, next};
+}
+
+bool is_blank_(char c)
+{
+    return c == ' ' or c == '\t';
+}
+
+// Parses the whole of [first, last) as a number, allowing surrounding blanks and a leading '+'
+template <typename T>
+bool parse_cell_(const char* first, const char* last, T& value)
+{
+    while (first < last and is_blank_(*first))
+    {
+        first++;
+    }
+    while (last > first and is_blank_(last[-1]))
+    {
+        last--;
+    }
+    if (first < last and *first == '+')
+    {
+        first++;
+    }
+    auto [ptr, ec] = std::from_chars(first, last, value);
+    return ec == std::errc() and ptr == last and first != last;
+}
+
+template <typename Label>
+bool parse_label_(const char* first, const char* last, Label& value)
+{
+    if (parse_cell_(first, last, value))
+    {
+        return true;
+    }
+    if constexpr (std::is_integral_v<Label>)
+    {
+        //Integer labels written as floats, like "1.0"
+        float f;
+        if (parse_cell_(first, last, f) and f == std::trunc(f))
+        {
+            value = static_cast<Label>(f);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Fills x (and label, unless label_column == n_cols) from one line with exactly n_cols cells
+template <typename Label>
+bool parse_line_(const char* p, const char* end, char delimiter, size_t n_cols, size_t label_column, std::span<float> x, Label& label)
+{
+    size_t feature = 0;
+    for (size_t col=0; col<n_cols; col++)
+    {
+        //The last cell takes the rest of the line, so an extra delimiter makes it fail to parse
+        auto cell_end = col+1 < n_cols? static_cast<const char*>(std::memchr(p, delimiter, end-p)):end;
+        if (cell_end == nullptr)
+        {
+            return false;
+        }
+        bool ok = col == label_column? parse_label_(p, cell_end, label):parse_cell_(p, cell_end, x[feature++]);
+        if (not ok)
+        {
+            return false;
+        }
+        p = cell_end+1;
+    }
+    return true;
+}
+
+struct Chunk
+{
+    const char* first;
+    const char* last;
+    size_t n_rows = 0, n_lines = 0;
+    size_t first_row = 0, first_line = 0;
+    std::vector<std::pair<size_t, size_t>> malformed{}; //(row, line)
+};
+}// namespace
+
+/*********
+* PUBLIC *
+*********/
+template <typename Label>
+CSVData<Label> read_csv(const std::string& path, const CSVParams& params)
+{
+    MappedFile file(path);
+    const char* begin = file.chars();
+    const char* end = begin+file.size();
+    CSVData<Label> data;
+    if (begin == end)
+    {
+        return data;
+    }
+
+    //The first line (header or not) gives the number of columns
+    Line first_line = next_line_(begin, end);
+    size_t n_cols = std::count(first_line.first, first_line.last, params.delimiter)+1;
+    const char* body = params.header? first_line.next:begin;
+    size_t line_offset = params.header? 2:1;
+
+    size_t label_column = n_cols; //n_cols means no label
+    if (params.label_column == CSVParams::LAST_COLUMN)
+    {
+        label_column = n_cols-1;
+    }
+    else if (params.label_column >= 0)
+    {
+        label_column = params.label_column;
+        if (label_column >= n_cols)
+        {
+            throw std::invalid_argument(std::format("label_column {} is out of range, the file has {} columns", params.label_column, n_cols));
+        }
+    }
+    else if (params.label_column != CSVParams::NO_LABEL)
+    {
+        throw std::invalid_argument(std::format("Invalid label_column {}", params.label_column));
+    }
+    bool has_label = label_column < n_cols;
+    size_t n_features = n_cols - has_label;
+
+    //Newline-aligned chunks
+    size_t body_size = end-body;
+    size_t n_chunks = std::max<size_t>(1, (body_size+CHUNK_BYTES-1)/CHUNK_BYTES);
+    std::vector<Chunk> chunks(n_chunks);
+    const char* chunk_first = body;
+    for (size_t k=0; k<n_chunks; k++)
+    {
+        const char* chunk_last = end;
+        if (k+1 < n_chunks)
+        {
+            chunk_last = std::max(chunk_first, body + (k+1)*(body_size/n_chunks));
+            chunk_last = next_line_(chunk_last, end).next;
+        }
+        chunks[k].first = chunk_first;
+        chunks[k].last = chunk_last;
+        chunk_first = chunk_last;
+    }
+
+    ThreadPool pool(effective_n_jobs(params.n_jobs));
+    pool.parallel_for(n_chunks, [&chunks](size_t k)
+    {
+        Chunk& chunk = chunks[k];
+        for (const char* p=chunk.first; p<chunk.last;)
+        {
+            Line line = next_line_(p, chunk.last);
+            chunk.n_rows += line.first != line.last;
+            chunk.n_lines++;
+            p = line.next;
+        }
+    });
+    size_t n_rows = 0, n_lines = 0;
+    for (Chunk& chunk: chunks)
+    {
+        chunk.first_row = n_rows;
+        chunk.first_line = n_lines;
+        n_rows += chunk.n_rows;
+        n_lines += chunk.n_lines;
+    }
+
+    data.X = Array2D<float>(n_rows, n_features);
+    data.y.resize(has_label? n_rows:0);
+    char delimiter = params.delimiter;
+    pool.parallel_for(n_chunks, [&](size_t k)
+    {
+        Chunk& chunk = chunks[k];
+        size_t row = chunk.first_row, line_number = chunk.first_line + line_offset;
+        Label unused_label{};
+        for (const char* p=chunk.first; p<chunk.last; line_number++)
+        {
+            Line line = next_line_(p, chunk.last);
+            p = line.next;
+            if (line.first == line.last)
+            {
+                continue;
+            }
+            Label& label = has_label? data.y[row]:unused_label;
+            if (not parse_line_(line.first, line.last, delimiter, n_cols, label_column, data.X[row], label))
+            {
+                chunk.malformed.emplace_back(row, line_number);
+            }
+            row++;
+        }
+    });
+
+    //Malformed rows are expected to be rare, so they are dropped with a copy after parsing
+    std::vector<size_t> bad_rows;
+    for (const Chunk& chunk: chunks)
+    {
+        for (auto [row, line]: chunk.malformed)
+        {
+            bad_rows.push_back(row);
+            data.malformed_lines.push_back(line);
+        }
+    }
+    if (not bad_rows.empty())
+    {
+        Array2D<float> X(n_rows-bad_rows.size(), n_features);
+        std::vector<Label> y;
+        y.reserve(has_label? X.size():0);
+        size_t out = 0, next_bad = 0;
+        for (size_t row=0; row<n_rows; row++)
+        {
+            if (next_bad < bad_rows.size() and bad_rows[next_bad] == row)
+            {
+                next_bad++;
+                continue;
+            }
+            std::ranges::copy(data.X[row], std::begin(X[out++]));
+            if (has_label)
+            {
+                y.push_back(data.y[row]);
+            }
+        }
+        data.X = std::move(X);
+        data.y = std::move(y);
+    }
+    return data;
+}
+
+template CSVData<int> read_csv<int>(const std::string&, const CSVParams&);
+template CSVData<float> read_csv<float>(const std::string&, const CSVParams&);
+}// namespace ML
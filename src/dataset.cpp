@@ -0,0 +1,184 @@
+#include <dataset.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <format>
+
+namespace ML
+{
+/**********
+* PRIVATE *
+**********/
+namespace
+{
+std::uint64_t align_up_(std::uint64_t offset)
+{
+    constexpr std::uint64_t A = DatasetHeader::ALIGNMENT;
+    return (offset+A-1)/A*A;
+}
+
+void pad_to_(std::ofstream& file, std::uint64_t offset)
+{
+    static constexpr char zeros[DatasetHeader::ALIGNMENT] = {};
+    auto pos = static_cast<std::uint64_t>(file.tellp());
+    file.write(zeros, offset-pos);
+}
+
+// Whether count floats starting at offset fit in a file of bytes bytes. offset and count come from the header, so
+// nothing is multiplied or added before it is known not to overflow.
+bool floats_fit_(std::uint64_t offset, std::uint64_t count, std::uint64_t bytes)
+{
+    return offset <= bytes and count <= (bytes-offset)/sizeof(float);
+}
+
+// Header, then write_features(file) which must write exactly rows*cols floats, then the labels
+template <typename WriteFeatures>
+void write_dataset_(const std::string& path, std::size_t rows, std::size_t cols, Layout layout, const DatasetLabels& y, WriteFeatures write_features)
+{
+    DatasetHeader header{};
+    std::copy_n(DatasetHeader::MAGIC, sizeof(header.magic), header.magic);
+    header.version = DatasetHeader::VERSION;
+    header.endian_tag = DatasetHeader::ENDIAN_TAG;
+    header.rows = rows;
+    header.cols = cols;
+    header.dtype = DType::float32;
+    header.layout = layout;
+    header.data_offset = align_up_(sizeof(DatasetHeader));
+
+    std::span<const std::byte> label_bytes;
+    if (auto labels = std::get_if<std::span<const float>>(&y))
+    {
+        header.label_dtype = DType::float32;
+        label_bytes = std::as_bytes(*labels);
+    }
+    else if (auto labels = std::get_if<std::span<const int>>(&y))
+    {
+        header.label_dtype = DType::int32;
+        label_bytes = std::as_bytes(*labels);
+    }
+    if (header.label_dtype != DType::none and label_bytes.size() != rows*sizeof(float))
+    {
+        throw std::invalid_argument(std::format("Number of labels ({}) does not match the number of rows ({})", label_bytes.size()/sizeof(float), rows));
+    }
+    header.label_offset = header.label_dtype == DType::none? 0:align_up_(header.data_offset + rows*cols*sizeof(float));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (not file)
+    {
+        throw std::runtime_error(std::format("Could not open {} for writing", path));
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pad_to_(file, header.data_offset);
+    write_features(file);
+    if (header.label_dtype != DType::none)
+    {
+        pad_to_(file, header.label_offset);
+        file.write(reinterpret_cast<const char*>(label_bytes.data()), label_bytes.size());
+    }
+    if (not file.flush())
+    {
+        throw std::runtime_error(std::format("Error while writing {}", path));
+    }
+}
+}// namespace
+
+/*********
+* PUBLIC *
+*********/
+void write_dataset(const std::string& path, Array2DView<const float> X, DatasetLabels y)
+{
+    auto [rows, cols] = X.shape();
+    write_dataset_(path, rows, cols, Layout::row_major, y, [&X](std::ofstream& file)
+    {
+        for (auto row: X)
+        {
+            file.write(reinterpret_cast<const char*>(row.data()), row.size_bytes());
+        }
+    });
+}
+
+void write_dataset(const std::string& path, const ColumnMajorArray2D<float>& X, DatasetLabels y)
+{
+    auto [rows, cols] = X.shape();
+    write_dataset_(path, rows, cols, Layout::column_major, y, [&X, cols](std::ofstream& file)
+    {
+        for (size_t j=0; j<cols; j++)
+        {
+            auto column = X[][j];
+            file.write(reinterpret_cast<const char*>(column.data()), column.size_bytes());
+        }
+    });
+}
+
+MappedDataset::MappedDataset(const std::string& path):
+    file_(path)
+{
+    if (file_.size() < sizeof(DatasetHeader))
+    {
+        throw std::runtime_error(std::format("Invalid dataset {}: too small for the header", path));
+    }
+    header_ = reinterpret_cast<const DatasetHeader*>(file_.bytes().data());
+    std::size_t bytes = file_.size();
+    std::uint64_t rows = header_->rows, cols = header_->cols;
+    const char* error = nullptr;
+    if (not std::equal(std::begin(DatasetHeader::MAGIC), std::end(DatasetHeader::MAGIC), header_->magic))
+    {
+        error = "not a dataset file";
+    }
+    else if (header_->endian_tag != DatasetHeader::ENDIAN_TAG)
+    {
+        error = "written on a machine with a different byte order";
+    }
+    else if (header_->version != DatasetHeader::VERSION)
+    {
+        error = "unsupported version";
+    }
+    else if (header_->dtype != DType::float32)
+    {
+        error = "unsupported feature type";
+    }
+    else if (header_->layout != Layout::row_major and header_->layout != Layout::column_major)
+    {
+        error = "unknown layout";
+    }
+    else if (header_->label_dtype != DType::none and header_->label_dtype != DType::float32 and header_->label_dtype != DType::int32)
+    {
+        error = "unsupported label type";
+    }
+    else if (header_->data_offset % DatasetHeader::ALIGNMENT != 0 or (rows != 0 and cols > bytes/rows) or not floats_fit_(header_->data_offset, rows*cols, bytes))
+    {
+        error = "truncated or corrupt feature block";
+    }
+    else if (header_->label_dtype != DType::none and (header_->label_offset % DatasetHeader::ALIGNMENT != 0 or not floats_fit_(header_->label_offset, rows, bytes)))
+    {
+        error = "truncated or corrupt label block";
+    }
+    if (error != nullptr)
+    {
+        throw std::runtime_error(std::format("Invalid dataset {}: {}", path, error));
+    }
+}
+
+Array2DView<const float> MappedDataset::X() const
+{
+    if (header_->layout != Layout::row_major)
+    {
+        throw std::logic_error("Dataset is stored column-major, use column(j)");
+    }
+    auto [rows, cols] = shape();
+    return Array2DView<const float>(reinterpret_cast<const float*>(file_.bytes().data()+header_->data_offset), rows, cols);
+}
+
+std::span<const float> MappedDataset::column(std::size_t j) const
+{
+    if (header_->layout != Layout::column_major)
+    {
+        throw std::logic_error("Dataset is stored row-major, use X()");
+    }
+    if (j >= header_->cols)
+    {
+        throw std::out_of_range(std::format("Column {} of a dataset with {} columns", j, header_->cols));
+    }
+    return {reinterpret_cast<const float*>(file_.bytes().data()+header_->data_offset)+j*header_->rows, header_->rows};
+}
+}// namespace ML
@@ -0,0 +1,257 @@
+#include <linalg.hpp>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace ML
+{
+/**********
+* PRIVATE *
+**********/
+namespace
+{
+constexpr size_t LANES = 8;
+
+// x*w accumulated in LANES independent partial sums, which the compiler keeps in a vector register without needing
+// -ffast-math to reorder a single sum
+template <typename Acc, typename T>
+Acc dot_(const T* x, const T* w, size_t n)
+{
+    Acc acc[LANES] = {};
+    size_t j = 0;
+    for (; j+LANES<=n; j+=LANES)
+    {
+        for (size_t l=0; l<LANES; l++)
+        {
+            acc[l] += static_cast<Acc>(x[j+l])*static_cast<Acc>(w[j+l]);
+        }
+    }
+    Acc sum = 0;
+    for (size_t l=0; l<LANES; l++)
+    {
+        sum += acc[l];
+    }
+    for (; j<n; j++)
+    {
+        sum += static_cast<Acc>(x[j])*static_cast<Acc>(w[j]);
+    }
+    return sum;
+}
+}// namespace
+
+/*********
+* PUBLIC *
+*********/
+bool cholesky_solve(Array2D<double> A, std::vector<double>& b, double rtol)
+{
+    auto [n, m] = A.shape();
+    assert(n == m and b.size() == n);
+    double max_diag = 0;
+    for (size_t i=0; i<n; i++)
+    {
+        max_diag = std::max(max_diag, A(i, i));
+    }
+    //Pivots this small relative to the diagonal mean the matrix is singular (or too ill-conditioned) for the caller
+    double tol = max_diag*rtol;
+
+    //Upper factor U with A = U^T*U, stored in the upper triangle of A
+    for (size_t j=0; j<n; j++)
+    {
+        double pivot = A(j, j);
+        for (size_t k=0; k<j; k++)
+        {
+            pivot -= A(k, j)*A(k, j);
+        }
+        if (not (pivot > tol))
+        {
+            return false;
+        }
+        pivot = std::sqrt(pivot);
+        A(j, j) = pivot;
+        for (size_t i=j+1; i<n; i++)
+        {
+            double s = A(j, i);
+            for (size_t k=0; k<j; k++)
+            {
+                s -= A(k, j)*A(k, i);
+            }
+            A(j, i) = s/pivot;
+        }
+    }
+
+    std::vector<double> z = b;
+    //U^T*z = b
+    for (size_t i=0; i<n; i++)
+    {
+        for (size_t k=0; k<i; k++)
+        {
+            z[i] -= A(k, i)*z[k];
+        }
+        z[i] /= A(i, i);
+    }
+    //U*x = z
+    for (size_t i=n; i-- > 0;)
+    {
+        for (size_t k=i+1; k<n; k++)
+        {
+            z[i] -= A(i, k)*z[k];
+        }
+        z[i] /= A(i, i);
+    }
+    b = std::move(z);
+    return true;
+}
+
+void qr_solve(Array2D<double> A, std::vector<double>& b, double rcond)
+{
+    auto [n, m] = A.shape();
+    assert(b.size() == n);
+    size_t steps = std::min(n, m);
+    std::vector<size_t> perm(m);
+    std::iota(std::begin(perm), std::end(perm), 0uz);
+
+    size_t rank = 0;
+    double r00 = 0;
+    for (size_t k=0; k<steps; k++)
+    {
+        //Pivot on the remaining column with the largest norm
+        size_t p = k;
+        double best = -1;
+        for (size_t j=k; j<m; j++)
+        {
+            double norm2 = 0;
+            for (size_t i=k; i<n; i++)
+            {
+                norm2 += A(i, j)*A(i, j);
+            }
+            if (norm2 > best)
+            {
+                best = norm2;
+                p = j;
+            }
+        }
+        if (p != k)
+        {
+            for (size_t i=0; i<n; i++)
+            {
+                std::swap(A(i, k), A(i, p));
+            }
+            std::swap(perm[k], perm[p]);
+        }
+
+        double norm = std::sqrt(best);
+        if (k == 0)
+        {
+            r00 = norm;
+        }
+        if (norm <= rcond*r00 or norm == 0)
+        {
+            break;
+        }
+
+        //Householder reflector H = I - 2vv^T/(v^Tv) mapping A(k:, k) onto -sign(A(k,k))*norm*e_k
+        double alpha = A(k, k) > 0? -norm:norm;
+        std::vector<double> v(n-k);
+        for (size_t i=k; i<n; i++)
+        {
+            v[i-k] = A(i, k);
+        }
+        v[0] -= alpha;
+        double vtv = std::inner_product(std::begin(v), std::end(v), std::begin(v), 0.);
+        if (vtv > 0)
+        {
+            for (size_t j=k; j<m; j++)
+            {
+                double s = 0;
+                for (size_t i=k; i<n; i++)
+                {
+                    s += v[i-k]*A(i, j);
+                }
+                s = 2*s/vtv;
+                for (size_t i=k; i<n; i++)
+                {
+                    A(i, j) -= s*v[i-k];
+                }
+            }
+            double s = 0;
+            for (size_t i=k; i<n; i++)
+            {
+                s += v[i-k]*b[i];
+            }
+            s = 2*s/vtv;
+            for (size_t i=k; i<n; i++)
+            {
+                b[i] -= s*v[i-k];
+            }
+        }
+        rank = k+1;
+    }
+
+    //R(0:rank, 0:rank)*z = (Q^T*b)(0:rank), dependent columns get 0
+    std::vector<double> z(m, 0.);
+    for (size_t i=rank; i-- > 0;)
+    {
+        double s = b[i];
+        for (size_t k=i+1; k<rank; k++)
+        {
+            s -= A(i, k)*z[k];
+        }
+        z[i] = s/A(i, i);
+    }
+    b.assign(m, 0.);
+    for (size_t i=0; i<m; i++)
+    {
+        b[perm[i]] = z[i];
+    }
+}
+
+void symmetric_solve(Array2D<double> A, std::vector<double>& b)
+{
+    if (cholesky_solve(A, b))
+    {
+        return;
+    }
+    size_t n = A.size();
+    for (size_t j=0; j<n; j++)
+    {
+        for (size_t k=0; k<j; k++)
+        {
+            A(j, k) = A(k, j);
+        }
+    }
+    qr_solve(std::move(A), b);
+}
+
+template <typename T, typename Acc>
+void linear_outputs(Array2DView<const T> X, std::span<const T> W, std::span<const T> b, Array2DView<Acc> Z)
+{
+    auto [n_samples, n_features] = X.shape();
+    size_t n_outputs = Z.shape().second;
+    assert(Z.size() == n_samples and W.size() == n_outputs*n_features and b.size() == n_outputs);
+    for (size_t i=0; i<n_samples; i++)
+    {
+        const T* x = X[i].data();
+        Acc* z = Z[i].data();
+        for (size_t k=0; k<n_outputs; k++)
+        {
+            z[k] = dot_<Acc>(x, W.data()+k*n_features, n_features) + static_cast<Acc>(b[k]);
+        }
+    }
+}
+
+template <typename T, typename Acc>
+void linear_outputs(std::span<const T> x, std::span<const T> W, std::span<const T> b, std::span<Acc> z)
+{
+    size_t n_features = x.size();
+    assert(W.size() == z.size()*n_features and b.size() == z.size());
+    for (size_t k=0; k<z.size(); k++)
+    {
+        z[k] = dot_<Acc>(x.data(), W.data()+k*n_features, n_features) + static_cast<Acc>(b[k]);
+    }
+}
+
+#define MLPP_INSTANTIATE_LINEAR_OUTPUTS_(T, Acc) \
+    template void linear_outputs<T, Acc>(Array2DView<const T>, std::span<const T>, std::span<const T>, Array2DView<Acc>); \
+    template void linear_outputs<T, Acc>(std::span<const T>, std::span<const T>, std::span<const T>, std::span<Acc>);
+MLPP_FOR_EACH_SCALAR(MLPP_INSTANTIATE_LINEAR_OUTPUTS_)
+}// namespace ML
@@ -6,51 +6,114 @@
 *********/
 namespace ML
 {
-LinearRegression::LinearRegression(float learning_rate, size_t max_iter):
+#ifdef __cpp_designated_initializers
+template <typename T, typename Acc>
+BasicLinearRegression<T, Acc>::BasicLinearRegression(ConstructorParams p):
+    learning_rate_(p.learning_rate), max_iter_(p.max_iter), n_jobs_(p.n_jobs), solver_(p.solver), sgd_(p.sgd), stopping_(p.stopping), l2_penalty_(p.l2_penalty),
+    predict_pool_(p.n_jobs)
+{}
+#endif
+template <typename T, typename Acc>
+BasicLinearRegression<T, Acc>::BasicLinearRegression(float learning_rate, size_t max_iter):
     learning_rate_(learning_rate), max_iter_(max_iter)
 {}
-LinearRegression::LinearRegression(float learning_rate): 
+template <typename T, typename Acc>
+BasicLinearRegression<T, Acc>::BasicLinearRegression(float learning_rate): 
     learning_rate_(learning_rate) {}
-LinearRegression::LinearRegression(size_t max_iter): 
+template <typename T, typename Acc>
+BasicLinearRegression<T, Acc>::BasicLinearRegression(size_t max_iter): 
     max_iter_(max_iter) {}
 
-LinearRegression& LinearRegression::fit(const Array2D<float>& X, const std::vector<float>& y)
+template <typename T, typename Acc>
+template <typename Matrix>
+BasicLinearRegression<T, Acc>& BasicLinearRegression<T, Acc>::fit_(const Matrix& X, const std::vector<T>& y)
 {
-    auto [gd_w, gd_b] = gradient_descent(X, y, learning_rate_, max_iter_, linear_cost_gradient);
-    w = std::move(gd_w);
-    b = gd_b;
-    n_features_ = X[0].size();
+    MLPP_PROFILE_DATA_SCOPE("LinearRegression::fit", X.size(), X.size()*X.shape().second*sizeof(T));
+    constexpr BasicLinearCostGradient<T, Acc> linear_cost_gradient{};
+    BasicFitResult<Acc> solution;
+    switch (solver_)
+    {
+    case Solver::normal_equations:
+        solution = least_squares<T, Acc>(X, y, l2_penalty_);
+        break;
+    case Solver::sgd:
+        solution = stochastic_gradient_descent(X, y, learning_rate_, max_iter_, linear_cost_gradient, sgd_, stopping_);
+        break;
+    case Solver::lbfgs:
+        solution = lbfgs(X, y, max_iter_, linear_cost_gradient, n_jobs_, stopping_);
+        break;
+    case Solver::newton:
+        throw std::invalid_argument("The least squares Hessian is constant, use Solver::normal_equations instead of Solver::newton");
+    case Solver::gradient_descent:
+        solution = gradient_descent(X, y, learning_rate_, max_iter_, linear_cost_gradient, n_jobs_, stopping_);
+        break;
+    }
+    w = detail::convert_<T>(std::move(solution.w));
+    b = static_cast<T>(solution.b);
+    n_iter_ = solution.n_iter;
+    loss_history_ = std::move(solution.loss_history);
+    n_features_ = X.shape().second;
     return *this;
 }
 
-std::vector<float> LinearRegression::predict(const Array2D<float>& X)
+template <typename T, typename Acc>
+template <typename Matrix>
+void BasicLinearRegression<T, Acc>::predict_into_(const Matrix& X, std::span<Acc> y_pred) const
 {
-    assert(X[0].size()==n_features_);
-    std::vector<float> y_pred;
-    y_pred.reserve(X.size());
-    for (auto sample: X)
+    MLPP_PROFILE_DATA_SCOPE("LinearRegression::predict", X.size(), X.size()*X.shape().second*sizeof(T));
+    assert(X.shape().second==n_features_ and y_pred.size()==X.size());
+    detail::predict_blocks_(X.size(), n_features_, predict_pool_, [&](size_t first, size_t last)
     {
-        float pred = 0;
-        for (size_t i=0; i<n_features_; i++)
-        {
-            pred += sample[i]*w[i];
-        }
-        pred += b;
-        y_pred.push_back(pred);
-    }
+        std::vector<T> buffer(detail::row_buffer_size_(X));
+        Array2DView<Acc> z(y_pred.data()+first, last-first, 1, 1);
+        detail::linear_outputs_<T, Acc>(X, first, last, w, std::span(&b, 1), z, buffer);
+    });
+}
 
+template <typename T, typename Acc>
+BasicLinearRegression<T, Acc>& BasicLinearRegression<T, Acc>::fit(Array2DView<const T> X, const std::vector<T>& y)
+{
+    return fit_(X, y);
+}
+template <typename T, typename Acc>
+BasicLinearRegression<T, Acc>& BasicLinearRegression<T, Acc>::fit(const BasicPolynomialExpansion<T>& X, const std::vector<T>& y)
+{
+    return fit_(X, y);
+}
+
+template <typename T, typename Acc>
+std::vector<Acc> BasicLinearRegression<T, Acc>::predict(Array2DView<const T> X) const
+{
+    std::vector<Acc> y_pred(X.size());
+    predict_into_(X, y_pred);
     return y_pred;
 }
-float LinearRegression::predict(const std::vector<float>& x)
+template <typename T, typename Acc>
+std::vector<Acc> BasicLinearRegression<T, Acc>::predict(const BasicPolynomialExpansion<T>& X) const
+{
+    std::vector<Acc> y_pred(X.size());
+    predict_into_(X, y_pred);
+    return y_pred;
+}
+template <typename T, typename Acc>
+void BasicLinearRegression<T, Acc>::predict_into(Array2DView<const T> X, std::span<Acc> y_pred) const
+{
+    predict_into_(X, y_pred);
+}
+template <typename T, typename Acc>
+void BasicLinearRegression<T, Acc>::predict_into(const BasicPolynomialExpansion<T>& X, std::span<Acc> y_pred) const
+{
+    predict_into_(X, y_pred);
+}
+template <typename T, typename Acc>
+Acc BasicLinearRegression<T, Acc>::predict(std::span<const T> x) const
 {
     assert(x.size()==n_features_);
-    float pred = 0;
-    for (size_t i=0; i<n_features_; i++)
-    {
-        pred += x[i]*w[i];
-    }
-    pred += b;
-    
+    Acc pred;
+    linear_outputs<T, Acc>(x, w, std::span(&b, 1), std::span(&pred, 1));
     return pred;
 }
+
+#define MLPP_INSTANTIATE_LINEAR_REGRESSION_(T, Acc) template class BasicLinearRegression<T, Acc>;
+MLPP_FOR_EACH_SCALAR(MLPP_INSTANTIATE_LINEAR_REGRESSION_)
 }// namespace ML
\ No newline at end of file
@@ -7,7 +7,6 @@
 #include <ranges>
 #include <numeric>
 #include <fstream>
-#include <sstream>
 #include <string>
 
 #include <array2D.hpp>
@@ -18,6 +17,7 @@
 #include <mlcommons.hpp>
 #include <polynomialfeatures.hpp>
 #include <generator.hpp>
+#include <csv.hpp>
 namespace ranges = std::ranges;
 using namespace ML;
 
@@ -69,63 +69,6 @@ void write_to_csv(const std::string& filename, const T& X, const std::vector<flo
     }
 }
 
-std::vector<std::string> getNextLineAndSplitIntoTokens(std::istream& str)
-{
-    std::vector<std::string>   result;
-    std::string                line;
-    std::getline(str,line);
-
-    std::stringstream          lineStream(line);
-    std::string                cell;
-
-    while(std::getline(lineStream,cell, ','))
-    {
-        if (cell[cell.size()-1] == '\r')
-        {
-            cell.erase(cell.size()-1);
-        }
-        result.push_back(cell);
-    }
-
-    
-    return result;
-}
-auto read_csv(const std::string& filename)
-{
-    std::ifstream csv_file(filename);
-    size_t n_columns = getNextLineAndSplitIntoTokens(csv_file).size()-1;
-    std::vector<float> X;
-    std::vector<int> y;
-    size_t rows = 0;
-    while(csv_file)
-    {
-        std::vector<std::string> line = getNextLineAndSplitIntoTokens(csv_file);
-        if(line.empty()) continue;
-
-        for (const auto& f: line | ranges::views::take(n_columns))
-        {
-            float value = std::stof(f);
-            X.push_back(value);
-        }
-
-        try
-        {
-            y.push_back(std::stoi(line.at(n_columns)));
-        }
-        catch(const std::exception& e)
-        {
-            std::cerr << e.what() << '\n';
-        }
-        
-        
-        rows++;
-    }
-    X.shrink_to_fit();
-    y.shrink_to_fit();
-    Array2D a_X (std::move(X), rows, n_columns);
-    return std::pair<Array2D<float>, std::vector<int>>{std::move(a_X), std::move(y)};
-}
-
 template <typename>
 struct TD;
 
@@ -157,19 +100,24 @@ struct A
 };
 int main()
 {
-    auto iota=std::views::iota(1, 4);
     bool with_replacement = false;
-    auto gen = (with_replacement?combinations_with_replacement(iota, 2):combinations(iota, 2));
-    print(gen);
+    if (with_replacement)
+    {
+        print(combinations_with_replacement(3, 2));
+    }
+    else
+    {
+        print(combinations(3, 2));
+    }
     PolynomialFeatures pf({.degree = std::pair(2, 3), .include_bias=false});
     std::cout << is_classifier<LinearRegression>() << std::endl;
 
     /*auto cancer = read_csv("haberman.csv");
 
-    Array2D<float>& X = cancer.first;
-    std::vector<int>& y = cancer.second;
+    Array2D<float>& X = cancer.X;
+    std::vector<int>& y = cancer.y;
     ZScoreNormalizer norm;
-    norm.fit_transform(X);
+    norm.fit_transform_inplace(X);
 
     LogisticRegression lr({.learning_rate=0.1, .max_iter=1000});
     
@@ -200,8 +148,8 @@ int main()
         std::cout << p << '\n';
     }
     ZScoreNormalizer norm;
-    X = norm.fit_transform(X);
-    X_test = norm.transform(X_test);
+    norm.fit_transform_inplace(X);
+    norm.transform_inplace(X_test);
     write_to_csv("houses_norm.csv", X, y);
     LinearRegression lr(0.1, 1000);
 
@@ -0,0 +1,122 @@
+#include <mappedfile.hpp>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ML
+{
+/**********
+* PRIVATE *
+**********/
+void MappedFile::unmap_()
+{
+    if (base_ != nullptr)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(base_);
+#else
+        munmap(const_cast<std::byte*>(base_), size_);
+#endif
+    }
+    base_ = nullptr;
+    size_ = 0;
+}
+
+/*********
+* PUBLIC *
+*********/
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error(std::format("Could not open {}", path));
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    size_ = file_size.QuadPart;
+    if (size_ == 0)
+    {
+        CloseHandle(file);
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping != nullptr)
+    {
+        base_ = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping); //The view keeps the mapping alive
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error(std::format("Could not open {}: {}", path, std::strerror(errno)));
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0)
+    {
+        size_ = st.st_size;
+    }
+    if (size_ == 0)
+    {
+        ::close(fd);
+        return;
+    }
+    void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    base_ = map == MAP_FAILED? nullptr:static_cast<const std::byte*>(map);
+    ::close(fd); //The mapping stays valid after closing
+#endif
+    if (base_ == nullptr)
+    {
+        throw std::runtime_error(std::format("Could not map {} ({} bytes)", path, size_));
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    unmap_();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept:
+    base_(std::exchange(other.base_, nullptr)),
+    size_(std::exchange(other.size_, 0))
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        unmap_();
+        base_ = std::exchange(other.base_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+void MappedFile::prefetch() const
+{
+    if (base_ == nullptr)
+    {
+        return;
+    }
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range{const_cast<std::byte*>(base_), size_};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    madvise(const_cast<std::byte*>(base_), size_, MADV_WILLNEED);
+#endif
+}
+}// namespace ML
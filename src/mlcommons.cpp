@@ -1,4 +1,7 @@
 #include <mlcommons.hpp>
+#include <linalg.hpp>
+#include <array>
+#include <limits>
 
 namespace ML
 {
@@ -18,65 +21,528 @@ float accuracy_score(const std::vector<int>& y, const std::vector<int>& y_pred)
     return correct_preds/static_cast<float>(y_pred.size());
 }
 
-float r2_score(const std::vector<float>& y, const std::vector<float>& y_pred)
+namespace
 {
-    //u=((y_true - y_pred)** 2).sum()
-    float u=0;
-    for (auto [y_true_i, y_pred_i]: std::views::zip(y, y_pred))
+// Losses of the linear models as a function of the raw prediction z = w*x+b: activation maps z to the model output
+// and cost is the per-sample cost, whose derivative with respect to z is activation(z)-y for both of them.
+struct SquaredLoss_
+{
+    template <typename S>
+    static S activation(S z)
     {
-        u+=(y_true_i-y_pred_i)*(y_true_i-y_pred_i);
+        return z;
     }
-    //v=((y_true - y_true.mean()) ** 2).sum()
-    float v = 0;
-    int mean = std::ranges::fold_left(y.begin(), y.end(), 0, std::plus<float>()) / y.size(); 
-    
-    for (float y_true_i: y)
+    template <typename S>
+    static S cost(S z, S y)
     {
-        v += (y_true_i-mean)*(y_true_i-mean);
+        return S(0.5)*(z-y)*(z-y);
     }
-    float R2 = 1-(u/v);
-    return R2;
-}
+};
+struct LogLoss_
+{
+    template <typename S>
+    static S activation(S z)
+    {
+        return sigmoid(z);
+    }
+    template <typename S>
+    static S cost(S z, S y)
+    {
+        //log(1+e^z) - y*z, written so that neither branch overflows
+        return std::log1p(std::exp(-std::abs(z))) + std::max(z, S(0)) - y*z;
+    }
+};
 
-std::pair<std::vector<float>, float> linear_cost_gradient(const Array2D<float>& X, const std::vector<float>& y, const std::vector<float>& w, float b)
+// Single pass over the selected rows of X: prediction, error and accumulation are done while the row is hot in cache.
+// The 1/n factor is folded into the error so dj_dw needs no extra pass. grad is only written, never resized, except for
+// grad.row_buffer holding the expanded row of a BasicPolynomialExpansion, which only allocates the first time.
+template <typename Loss, bool with_cost, typename Matrix, typename T, typename Acc>
+void accumulate_gradient_(const Matrix& X, const std::vector<T>& y, const std::vector<Acc>& w, Acc b, BasicGradient<Acc, T>& grad, const ranges::range auto& rows, Acc inv_n)
 {
-    size_t n = X.size();    
-    std::vector<float> dj_dw(X[0].size(), 0);
-    float dj_db = 0;
+    size_t n_features = w.size();
+    assert(grad.dj_dw.size() == n_features);
+    grad.row_buffer.resize(detail::row_buffer_size_(X));
+    Acc* dj_dw = grad.dj_dw.data();
+    std::fill_n(dj_dw, n_features, Acc(0));
+    Acc dj_db = 0, cost = 0;
 
-    for (size_t i=0; i<n; i++)
+    for (size_t i: rows)
     {
-        float f_wb = dot_product(w, X[i]) + b;
-        float err = f_wb - y[i];
-        ranges::transform(X[i], dj_dw, std::begin(dj_dw), [err, n](float x, float dw) { return err*x + dw; });
+        auto x = detail::row_(X, i, grad.row_buffer);
+        const T* x_i = x.data();
+        Acc z = dot_product<Acc>(w, x) + b;
+        Acc err = (Loss::activation(z) - static_cast<Acc>(y[i]))*inv_n;
+        for (size_t j=0; j<n_features; j++)
+        {
+            dj_dw[j] += err*x_i[j];
+        }
         dj_db += err;
+        if constexpr (with_cost)
+        {
+            cost += Loss::cost(z, static_cast<Acc>(y[i]));
+        }
+    }
+    grad.dj_db = dj_db;
+    grad.cost = cost*inv_n;
+}
+
+template <typename Loss, typename Matrix, typename T, typename Acc>
+void accumulate_gradient_(const Matrix& X, const std::vector<T>& y, const std::vector<Acc>& w, Acc b, BasicGradient<Acc, T>& grad, const ranges::range auto& rows, Acc inv_n)
+{
+    if (grad.compute_cost)
+    {
+        accumulate_gradient_<Loss, true>(X, y, w, b, grad, rows, inv_n);
+    }
+    else
+    {
+        accumulate_gradient_<Loss, false>(X, y, w, b, grad, rows, inv_n);
     }
-    ranges::transform(dj_dw, std::begin(dj_dw), [&n](float dw) { return dw/n; });
-    return {std::move(dj_dw), dj_db/n};
 }
 
-float sigmoid(float z)
+template <typename Loss, typename Matrix, typename T, typename Acc>
+Acc accumulate_cost_(const Matrix& X, const std::vector<T>& y, const std::vector<Acc>& w, Acc b, const ranges::range auto& rows, Acc inv_n)
+{
+    std::vector<T> buffer(detail::row_buffer_size_(X));
+    Acc cost = 0;
+    for (size_t i: rows)
+    {
+        cost += Loss::cost(dot_product<Acc>(w, detail::row_(X, i, buffer)) + b, static_cast<Acc>(y[i]));
+    }
+    return cost*inv_n;
+}
+}// namespace
+
+// Members of a gradient function on samples of type Matrix, targets of type Y and a bias of type B, all forwarding to
+// the kernels of its loss: rows [first, last) are scaled by 1/X.size(), a list of rows by 1/rows.size().
+#define MLPP_DEFINE_GRADIENT_MEMBERS_(Matrix, Gradient, Y, B, Loss, accumulate_gradient, accumulate_cost) \
+template <typename T, typename Acc> \
+void Gradient<T, Acc>::operator()(Matrix X, const Y& y, const std::vector<Acc>& w, B b, gradient_type& grad) const \
+{ \
+    accumulate_gradient<Loss>(X, y, w, b, grad, std::views::iota(0uz, X.size()), Acc(1)/X.size()); \
+} \
+template <typename T, typename Acc> \
+void Gradient<T, Acc>::operator()(Matrix X, const Y& y, const std::vector<Acc>& w, B b, gradient_type& grad, size_t first, size_t last) const \
+{ \
+    assert(last <= X.size()); \
+    accumulate_gradient<Loss>(X, y, w, b, grad, std::views::iota(first, last), Acc(1)/X.size()); \
+} \
+template <typename T, typename Acc> \
+void Gradient<T, Acc>::operator()(Matrix X, const Y& y, const std::vector<Acc>& w, B b, gradient_type& grad, std::span<const size_t> rows) const \
+{ \
+    accumulate_gradient<Loss>(X, y, w, b, grad, rows, Acc(1)/rows.size()); \
+} \
+template <typename T, typename Acc> \
+Acc Gradient<T, Acc>::cost(Matrix X, const Y& y, const std::vector<Acc>& w, B b) const \
+{ \
+    return accumulate_cost<Loss>(X, y, w, b, std::views::iota(0uz, X.size()), Acc(1)/X.size()); \
+} \
+template <typename T, typename Acc> \
+Acc Gradient<T, Acc>::cost(Matrix X, const Y& y, const std::vector<Acc>& w, B b, size_t first, size_t last) const \
+{ \
+    assert(last <= X.size()); \
+    return accumulate_cost<Loss>(X, y, w, b, std::views::iota(first, last), Acc(1)/X.size()); \
+}
+
+MLPP_FOR_EACH_SAMPLE_MATRIX(MLPP_DEFINE_GRADIENT_MEMBERS_, BasicLinearCostGradient, std::vector<T>, Acc, SquaredLoss_, accumulate_gradient_, accumulate_cost_)
+MLPP_FOR_EACH_SAMPLE_MATRIX(MLPP_DEFINE_GRADIENT_MEMBERS_, BasicLogCostGradient, std::vector<T>, Acc, LogLoss_, accumulate_gradient_, accumulate_cost_)
+
+namespace
+{
+// Losses of the K-output models over a row of raw outputs z_k = w_k*x+b_k. RowCost accumulates the cost of one
+// sample output by output, so it needs no buffer; activation turns the row into the model outputs in place. For both
+// of them the derivative of the cost with respect to z_k is activation(z)_k - [k == y].
+struct OvRLoss_
+{
+    template <typename S>
+    struct RowCost
+    {
+        S cost = 0;
+        void add(S z, bool target)
+        {
+            cost += LogLoss_::cost(z, S(target));
+        }
+        S value() const
+        {
+            return cost;
+        }
+    };
+    template <typename S>
+    static void activation(std::span<S> z)
+    {
+        ranges::transform(z, std::begin(z), sigmoid<S>);
+    }
+};
+struct SoftmaxLoss_
+{
+    //log(sum_k e^z_k) - z_y with a running maximum (online log-sum-exp)
+    template <typename S>
+    struct RowCost
+    {
+        S max_z = -std::numeric_limits<S>::infinity();
+        S sum = 0, z_target = 0;
+        void add(S z, bool target)
+        {
+            if (target)
+            {
+                z_target = z;
+            }
+            if (z > max_z)
+            {
+                sum = sum*std::exp(max_z-z) + 1;
+                max_z = z;
+            }
+            else
+            {
+                sum += std::exp(z-max_z);
+            }
+        }
+        S value() const
+        {
+            return max_z + std::log(sum) - z_target;
+        }
+    };
+    template <typename S>
+    static void activation(std::span<S> z)
+    {
+        softmax(z);
+    }
+};
+
+template <typename Loss, bool with_cost, typename Matrix, typename T, typename Acc>
+void accumulate_multi_gradient_(const Matrix& X, const std::vector<size_t>& y, const std::vector<Acc>& w, const std::vector<Acc>& b, BasicGradient<std::vector<Acc>, T>& grad, const ranges::range auto& rows, Acc inv_n)
 {
-    z = std::clamp(z, -500.f, 500.f);
-    return 1.f / (1.f+std::exp(-z));
+    constexpr size_t BLOCK_ROWS = 32;
+    size_t n_features = X.shape().second, n_outputs = b.size(), row_buffer = detail::row_buffer_size_(X);
+    assert(w.size() == n_outputs*n_features and grad.dj_dw.size() == w.size() and grad.dj_db.size() == n_outputs);
+    //Z, and the expanded rows of the block for a BasicPolynomialExpansion. Only allocate the first time
+    grad.work.resize(BLOCK_ROWS*n_outputs);
+    grad.row_buffer.resize(BLOCK_ROWS*row_buffer);
+    ranges::fill(grad.dj_dw, Acc(0));
+    ranges::fill(grad.dj_db, Acc(0));
+    Acc* Z = grad.work.data();
+    T* row_buffers = grad.row_buffer.data();
+    Acc cost = 0;
+
+    std::array<size_t, BLOCK_ROWS> block;
+    std::array<const T*, BLOCK_ROWS> x_block;
+    auto it = std::begin(rows);
+    auto end = std::end(rows);
+    while (it != end)
+    {
+        size_t block_size = 0;
+        for (; block_size<BLOCK_ROWS and it != end; ++it)
+        {
+            block[block_size++] = *it;
+        }
+
+        //Z = X_block*W^T + b, then turned into the error of every output
+        for (size_t r=0; r<block_size; r++)
+        {
+            auto x = detail::row_(X, block[r], std::span(row_buffers+r*row_buffer, row_buffer));
+            x_block[r] = x.data();
+            size_t y_r = y[block[r]];
+            std::span<Acc> z(Z+r*n_outputs, n_outputs);
+            typename Loss::template RowCost<Acc> row_cost;
+            for (size_t k=0; k<n_outputs; k++)
+            {
+                z[k] = dot_product<Acc>(std::span(w.data()+k*n_features, n_features), x) + b[k];
+                if constexpr (with_cost)
+                {
+                    row_cost.add(z[k], k == y_r);
+                }
+            }
+            if constexpr (with_cost)
+            {
+                cost += row_cost.value();
+            }
+            Loss::activation(z);
+            z[y_r] -= 1;
+            for (Acc& e: z)
+            {
+                e *= inv_n;
+            }
+        }
+
+        //dW += E^T*X_block, one class at a time so its gradient row stays in cache while the block streams through
+        for (size_t k=0; k<n_outputs; k++)
+        {
+            Acc* dw_k = grad.dj_dw.data()+k*n_features;
+            Acc db_k = 0;
+            for (size_t r=0; r<block_size; r++)
+            {
+                Acc e = Z[r*n_outputs+k];
+                const T* x = x_block[r];
+                for (size_t j=0; j<n_features; j++)
+                {
+                    dw_k[j] += e*x[j];
+                }
+                db_k += e;
+            }
+            grad.dj_db[k] += db_k;
+        }
+    }
+    grad.cost = cost*inv_n;
 }
 
-std::pair<std::vector<float>, float> log_cost_gradient(const Array2D<float>& X, const std::vector<float>& y, const std::vector<float>& w, float b)
+template <typename Loss, typename Matrix, typename T, typename Acc>
+void accumulate_multi_gradient_(const Matrix& X, const std::vector<size_t>& y, const std::vector<Acc>& w, const std::vector<Acc>& b, BasicGradient<std::vector<Acc>, T>& grad, const ranges::range auto& rows, Acc inv_n)
 {
-    size_t n = X.size();    
-    std::vector<float> dj_dw(X[0].size(), 0);
-    float dj_db = 0;
+    if (grad.compute_cost)
+    {
+        accumulate_multi_gradient_<Loss, true>(X, y, w, b, grad, rows, inv_n);
+    }
+    else
+    {
+        accumulate_multi_gradient_<Loss, false>(X, y, w, b, grad, rows, inv_n);
+    }
+}
 
+template <typename Loss, typename Matrix, typename Acc>
+Acc accumulate_multi_cost_(const Matrix& X, const std::vector<size_t>& y, const std::vector<Acc>& w, const std::vector<Acc>& b, const ranges::range auto& rows, Acc inv_n)
+{
+    size_t n_features = X.shape().second;
+    std::vector<detail::matrix_scalar_t<Matrix>> buffer(detail::row_buffer_size_(X));
+    Acc cost = 0;
+    for (size_t i: rows)
+    {
+        typename Loss::template RowCost<Acc> row_cost;
+        auto x = detail::row_(X, i, buffer);
+        for (size_t k=0; k<b.size(); k++)
+        {
+            row_cost.add(dot_product<Acc>(std::span(w.data()+k*n_features, n_features), x) + b[k], k == y[i]);
+        }
+        cost += row_cost.value();
+    }
+    return cost*inv_n;
+}
+}// namespace
+
+MLPP_FOR_EACH_SAMPLE_MATRIX(MLPP_DEFINE_GRADIENT_MEMBERS_, BasicOvRLogCostGradient, std::vector<size_t>, const std::vector<Acc>&, OvRLoss_, accumulate_multi_gradient_, accumulate_multi_cost_)
+MLPP_FOR_EACH_SAMPLE_MATRIX(MLPP_DEFINE_GRADIENT_MEMBERS_, BasicSoftmaxCostGradient, std::vector<size_t>, const std::vector<Acc>&, SoftmaxLoss_, accumulate_multi_gradient_, accumulate_multi_cost_)
+#undef MLPP_DEFINE_GRADIENT_MEMBERS_
+
+namespace
+{
+// Adds [X 1]^T*diag(s)*[X 1] (upper triangle only) to gram and, when y is not empty, [X 1]^T*diag(s)*y to rhs, over rows
+// [first, last) with s_i = row_weight(i, x_i) >= 0. Rows are copied block by block into a transposed double buffer
+// scaled by sqrt(s_i), so every entry of the Gram matrix is a contiguous dot product over the block and the Gram matrix
+// is updated once per block instead of once per row.
+template <typename Matrix, typename RowWeight>
+void accumulate_gram_(const Matrix& X, std::span<const detail::matrix_scalar_t<Matrix>> y, size_t first, size_t last, RowWeight row_weight, Array2D<double>& gram, std::vector<double>& rhs)
+{
+    constexpr size_t BLOCK_ROWS = 64;
+    size_t n_features = X.shape().second, m = n_features+1;
+    std::vector<detail::matrix_scalar_t<Matrix>> row_buffer(detail::row_buffer_size_(X));
+    //block[j][r] = sqrt(s)*X[start+r][j], last row is the intercept column. Padded, so every row is cache line aligned
+    Array2D<double, PaddedStorage> block(m, BLOCK_ROWS);
+    alignas(CACHE_LINE_SIZE) std::array<double, BLOCK_ROWS> y_block{};
+    constexpr size_t ALIGN = decltype(block)::row_alignment;
+
+    for (size_t start=first; start<last; start+=BLOCK_ROWS)
+    {
+        size_t rows = std::min(BLOCK_ROWS, last-start);
+        if (rows < BLOCK_ROWS)
+        {
+            for (size_t j=0; j<m; j++)
+            {
+                std::fill(std::begin(block[j])+rows, std::end(block[j]), 0.);
+            }
+        }
+        for (size_t r=0; r<rows; r++)
+        {
+            auto x_r = detail::row_(X, start+r, row_buffer);
+            double sqrt_s = std::sqrt(static_cast<double>(row_weight(start+r, x_r)));
+            for (size_t j=0; j<n_features; j++)
+            {
+                block(j, r) = sqrt_s*static_cast<double>(x_r[j]);
+            }
+            block(n_features, r) = sqrt_s;
+            if (not y.empty())
+            {
+                y_block[r] = sqrt_s*static_cast<double>(y[start+r]);
+            }
+        }
+        for (size_t j=0; j<m; j++)
+        {
+            const double* col_j = std::assume_aligned<ALIGN>(block[j].data());
+            if (not y.empty())
+            {
+                double y_dot = 0;
+                for (size_t r=0; r<rows; r++)
+                {
+                    y_dot += col_j[r]*y_block[r];
+                }
+                rhs[j] += y_dot;
+            }
+            for (size_t k=j; k<m; k++)
+            {
+                const double* col_k = std::assume_aligned<ALIGN>(block[k].data());
+                double dot = 0;
+                for (size_t r=0; r<BLOCK_ROWS; r++)
+                {
+                    dot += col_j[r]*col_k[r];
+                }
+                gram(j, k) += dot;
+            }
+        }
+    }
+}
+
+// Adds the row a (with right-hand side beta) to the n x n triangular factor R of the rows seen so far and to c = Q^T*rhs:
+// a Givens rotation per column zeros a[j] against R(j, j). Overwrites a.
+void givens_add_row_(Array2D<double>& R, std::vector<double>& c, std::span<double> a, double beta)
+{
+    size_t n = a.size();
+    for (size_t j=0; j<n; j++)
+    {
+        if (a[j] == 0)
+        {
+            continue;
+        }
+        double r = std::hypot(R(j, j), a[j]), cs = R(j, j)/r, sn = a[j]/r;
+        R(j, j) = r;
+        for (size_t k=j+1; k<n; k++)
+        {
+            double r_jk = R(j, k);
+            R(j, k) = cs*r_jk + sn*a[k];
+            a[k] = cs*a[k] - sn*r_jk;
+        }
+        double c_j = c[j];
+        c[j] = cs*c_j + sn*beta;
+        beta = cs*beta - sn*c_j;
+    }
+}
+
+// Ridge least squares by QR of the design matrix itself, for systems whose normal equations are too ill-conditioned:
+// the features and y are centred, which takes the intercept out of the problem, and sqrt(l2_penalty)*I rows are
+// appended below the data. The rows are streamed into an n_features x n_features R by Givens rotations, so neither the
+// design matrix nor an expansion is ever materialized, then the small system R*w = Q^T*y is solved by the pivoted QR
+// that handles rank deficiency. Returns [w b].
+template <typename Matrix, typename T>
+std::vector<double> centred_qr_solve_(const Matrix& X, const std::vector<T>& y, float l2_penalty)
+{
+    size_t n = X.size(), n_features = X.shape().second, ridge_rows = l2_penalty > 0? n_features:0;
+    std::vector<detail::matrix_scalar_t<Matrix>> row_buffer(detail::row_buffer_size_(X));
+    std::vector<double> mean(n_features, 0.);
+    double y_mean = 0;
     for (size_t i=0; i<n; i++)
     {
-        float f_wb = sigmoid(dot_product(w, X[i]) + b);
-        float err = f_wb - y[i];
-        ranges::transform(X[i], dj_dw, std::begin(dj_dw), [err, n](float x, float dw) { return err*x + dw; });
-        dj_db += err;
+        auto x_i = detail::row_(X, i, row_buffer);
+        for (size_t j=0; j<n_features; j++)
+        {
+            mean[j] += static_cast<double>(x_i[j]);
+        }
+        y_mean += static_cast<double>(y[i]);
+    }
+    ranges::transform(mean, std::begin(mean), [n](double s) { return s/n; });
+    y_mean /= n;
+
+    Array2D<double> R(n_features, n_features, 0.);
+    std::vector<double> rhs(n_features, 0.), a(n_features);
+    for (size_t i=0; i<n; i++)
+    {
+        auto x_i = detail::row_(X, i, row_buffer);
+        for (size_t j=0; j<n_features; j++)
+        {
+            a[j] = static_cast<double>(x_i[j]) - mean[j];
+        }
+        givens_add_row_(R, rhs, a, static_cast<double>(y[i]) - y_mean);
     }
-    ranges::transform(dj_dw, std::begin(dj_dw), [&n](float dw) { return dw/n; });
-    return {std::move(dj_dw), dj_db/n};
+    for (size_t j=0; j<ridge_rows; j++)
+    {
+        ranges::fill(a, 0.);
+        a[j] = std::sqrt(static_cast<double>(l2_penalty));
+        givens_add_row_(R, rhs, a, 0.);
+    }
+    qr_solve(std::move(R), rhs);
+    rhs.push_back(y_mean - std::inner_product(std::begin(mean), std::end(mean), std::begin(rhs), 0.));
+    return rhs;
 }
 
+template <typename Acc, typename Matrix, typename T>
+BasicFitResult<Acc> least_squares_(const Matrix& X, const std::vector<T>& y, float l2_penalty)
+{
+    MLPP_PROFILE_DATA_SCOPE("least_squares", X.size(), X.size()*X.shape().second*sizeof(T));
+    size_t n_features = X.shape().second, m = n_features+1;
 
-}
\ No newline at end of file
+    Array2D<double> gram(m, m, 0.);
+    std::vector<double> solution(m, 0.);
+    accumulate_gram_(X, y, 0, X.size(), [](size_t, std::span<const T>) { return 1.f; }, gram, solution);
+    for (size_t j=0; j<n_features; j++)
+    {
+        gram(j, j) += l2_penalty;
+    }
+    //Solving the normal equations squares the condition number of X. Past CHOLESKY_RTOL that loses more than float
+    //precision, so the problem is solved again by QR of the centred design matrix, which keeps cond(X)
+    constexpr double CHOLESKY_RTOL = 1e-9;
+    if (not cholesky_solve(std::move(gram), solution, CHOLESKY_RTOL))
+    {
+        solution = centred_qr_solve_(X, y, l2_penalty);
+    }
+
+    std::vector<Acc> w(std::begin(solution), std::begin(solution)+n_features);
+    return {std::move(w), static_cast<Acc>(solution[n_features]), 1};
+}
+
+template <typename Matrix, typename Acc>
+void logistic_hessian_(const Matrix& X, const std::vector<Acc>& w, Acc b, Array2D<double>& H, size_t first, size_t last)
+{
+    assert(last <= X.size());
+    size_t m = w.size()+1;
+    if (H.shape() != std::pair(m, m))
+    {
+        H = Array2D<double>(m, m);
+    }
+    for (auto row: H)
+    {
+        ranges::fill(row, 0.);
+    }
+    std::vector<double> unused;
+    Acc inv_n = Acc(1)/X.size();
+    //d2J/dz2 = p*(1-p) for every sample
+    accumulate_gram_(X, {}, first, last, [&](size_t, auto x)
+    {
+        Acc p = sigmoid(dot_product<Acc>(w, x) + b);
+        return p*(1-p)*inv_n;
+    }, H, unused);
+    for (size_t j=0; j<m; j++)
+    {
+        for (size_t k=0; k<j; k++)
+        {
+            H(j, k) = H(k, j);
+        }
+    }
+}
+}// namespace
+
+template <typename T, typename Acc>
+BasicFitResult<Acc> least_squares(Array2DView<const std::type_identity_t<T>> X, const std::vector<T>& y, float l2_penalty)
+{
+    return least_squares_<Acc>(X, y, l2_penalty);
+}
+template <typename T, typename Acc>
+BasicFitResult<Acc> least_squares(const BasicPolynomialExpansion<T>& X, const std::vector<T>& y, float l2_penalty)
+{
+    return least_squares_<Acc>(X, y, l2_penalty);
+}
+
+template <typename T, typename Acc>
+void BasicLogCostGradient<T, Acc>::hessian(Array2DView<const T> X, const std::vector<Acc>& w, Acc b, Array2D<double>& H, size_t first, size_t last) const
+{
+    logistic_hessian_(X, w, b, H, first, last);
+}
+template <typename T, typename Acc>
+void BasicLogCostGradient<T, Acc>::hessian(const BasicPolynomialExpansion<T>& X, const std::vector<Acc>& w, Acc b, Array2D<double>& H, size_t first, size_t last) const
+{
+    logistic_hessian_(X, w, b, H, first, last);
+}
+
+#define MLPP_INSTANTIATE_GRADIENTS_(T, Acc) \
+    template struct BasicLinearCostGradient<T, Acc>; \
+    template struct BasicLogCostGradient<T, Acc>; \
+    template struct BasicOvRLogCostGradient<T, Acc>; \
+    template struct BasicSoftmaxCostGradient<T, Acc>; \
+    template BasicFitResult<Acc> least_squares<T, Acc>(Array2DView<const T>, const std::vector<T>&, float); \
+    template BasicFitResult<Acc> least_squares<T, Acc>(const BasicPolynomialExpansion<T>&, const std::vector<T>&, float);
+MLPP_FOR_EACH_SCALAR(MLPP_INSTANTIATE_GRADIENTS_)
+}
@@ -0,0 +1,379 @@
+#include <modelfile.hpp>
+#include <algorithm>
+#include <fstream>
+#include <format>
+
+namespace ML
+{
+/**********
+* PRIVATE *
+**********/
+namespace
+{
+std::uint64_t align_up_(std::uint64_t offset)
+{
+    constexpr std::uint64_t A = ModelHeader::ALIGNMENT;
+    return (offset+A-1)/A*A;
+}
+
+void pad_to_(std::ofstream& file, std::uint64_t offset)
+{
+    static constexpr char zeros[ModelHeader::ALIGNMENT] = {};
+    auto pos = static_cast<std::uint64_t>(file.tellp());
+    file.write(zeros, offset-pos);
+}
+
+std::size_t dtype_size_(DType dtype)
+{
+    switch (dtype)
+    {
+    case DType::float16:
+        return 2;
+    case DType::float32:
+    case DType::int32:
+    case DType::uint32:
+        return 4;
+    case DType::float64:
+    case DType::int64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+template <typename T>
+std::span<const T> one_(const T& value)
+{
+    return {&value, 1};
+}
+
+// Far more threads than any machine has cores, a larger n_jobs is taken for a damaged file rather than started
+constexpr std::int64_t MAX_N_JOBS_ = 1 << 12;
+
+// Config values are checked before use: n_jobs goes straight to effective_n_jobs, which rejects 0 with an
+// std::invalid_argument and trusts any other value, and negative sizes would wrap around once stored as size_t
+int n_jobs_(const MappedModels& in, std::size_t model, std::int64_t n_jobs)
+{
+    if (n_jobs == 0 or n_jobs < -MAX_N_JOBS_ or n_jobs > MAX_N_JOBS_)
+    {
+        in.corrupt(std::format("invalid n_jobs {} in model {}", n_jobs, model));
+    }
+    return static_cast<int>(n_jobs);
+}
+std::size_t size_(const MappedModels& in, std::size_t model, std::int64_t size)
+{
+    if (size < 0)
+    {
+        in.corrupt(std::format("negative size {} in model {}", size, model));
+    }
+    return static_cast<std::size_t>(size);
+}
+bool flag_(const MappedModels& in, std::size_t model, std::int64_t flag)
+{
+    if (flag != 0 and flag != 1)
+    {
+        in.corrupt(std::format("invalid flag {} in model {}", flag, model));
+    }
+    return flag != 0;
+}
+}// namespace
+
+const ModelSection& MappedModels::find_(std::size_t model, ModelField field, DType dtype, std::size_t count) const
+{
+    auto it = std::ranges::find_if(sections_, [=](const ModelSection& s) { return s.model == model and s.field == field; });
+    if (it == std::end(sections_))
+    {
+        corrupt(std::format("section {} of model {} is missing", static_cast<std::uint32_t>(field), model));
+    }
+    if (it->dtype != dtype or (count != std::dynamic_extent and it->count != count))
+    {
+        corrupt(std::format("section {} of model {} has the wrong type or size", static_cast<std::uint32_t>(field), model));
+    }
+    return *it;
+}
+
+/*********
+* PUBLIC *
+*********/
+void ModelWriter::begin_model(ModelType type)
+{
+    type_ = type;
+    n_models_++;
+}
+
+void ModelWriter::write(const std::string& path) const
+{
+    ModelHeader header{};
+    std::copy_n(ModelHeader::MAGIC, sizeof(header.magic), header.magic);
+    header.version = ModelHeader::VERSION;
+    header.endian_tag = ModelHeader::ENDIAN_TAG;
+    header.n_models = n_models_;
+    header.n_sections = sections_.size();
+    header.sections_offset = align_up_(sizeof(ModelHeader));
+
+    std::vector<ModelSection> table;
+    std::uint64_t offset = header.sections_offset + sections_.size()*sizeof(ModelSection);
+    for (const Pending_& pending: sections_)
+    {
+        table.push_back(pending.section);
+        table.back().offset = offset = align_up_(offset);
+        offset += pending.bytes.size();
+    }
+    header.file_size = offset;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (not file)
+    {
+        throw std::runtime_error(std::format("Could not open {} for writing", path));
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pad_to_(file, header.sections_offset);
+    file.write(reinterpret_cast<const char*>(table.data()), table.size()*sizeof(ModelSection));
+    for (std::size_t k=0; k<table.size(); k++)
+    {
+        pad_to_(file, table[k].offset);
+        file.write(reinterpret_cast<const char*>(sections_[k].bytes.data()), sections_[k].bytes.size());
+    }
+    if (not file.flush())
+    {
+        throw std::runtime_error(std::format("Error while writing {}", path));
+    }
+}
+
+MappedModels::MappedModels(const std::string& path):
+    path_(path),
+    file_(std::make_shared<const MappedFile>(path))
+{
+    if (file_->size() < sizeof(ModelHeader))
+    {
+        corrupt("too small for the header");
+    }
+    header_ = reinterpret_cast<const ModelHeader*>(file_->bytes().data());
+    std::uint64_t bytes = file_->size();
+    if (not std::equal(std::begin(ModelHeader::MAGIC), std::end(ModelHeader::MAGIC), header_->magic))
+    {
+        corrupt("not a model file");
+    }
+    else if (header_->endian_tag != ModelHeader::ENDIAN_TAG)
+    {
+        corrupt("written on a machine with a different byte order");
+    }
+    else if (header_->version != ModelHeader::VERSION)
+    {
+        corrupt(std::format("unsupported version {}", header_->version));
+    }
+    else if (header_->file_size != bytes or header_->sections_offset % ModelHeader::ALIGNMENT != 0 or
+        header_->n_sections > bytes/sizeof(ModelSection) or header_->sections_offset + header_->n_sections*sizeof(ModelSection) > bytes)
+    {
+        corrupt("truncated or corrupt section table");
+    }
+    sections_ = {reinterpret_cast<const ModelSection*>(file_->bytes().data()+header_->sections_offset), header_->n_sections};
+    for (const ModelSection& s: sections_)
+    {
+        std::size_t size = dtype_size_(s.dtype);
+        if (s.model >= header_->n_models or size == 0 or s.offset % ModelHeader::ALIGNMENT != 0 or
+            s.offset > bytes or s.count > (bytes-s.offset)/size)
+        {
+            corrupt("truncated or corrupt section");
+        }
+    }
+}
+
+ModelType MappedModels::type(std::size_t model) const
+{
+    auto it = std::ranges::find(sections_, model, &ModelSection::model);
+    if (it == std::end(sections_))
+    {
+        corrupt(std::format("model {} has no sections", model));
+    }
+    return it->type;
+}
+
+void MappedModels::expect(std::size_t model, ModelType type) const
+{
+    if (this->type(model) != type)
+    {
+        corrupt(std::format("model {} has type {}, expected {}", model, static_cast<std::uint32_t>(this->type(model)), static_cast<std::uint32_t>(type)));
+    }
+}
+
+void MappedModels::corrupt(std::string_view what) const
+{
+    throw std::runtime_error(std::format("Invalid model file {}: {}", path_, what));
+}
+
+template <typename T, typename Acc>
+void ModelSerializer<BasicLinearRegression<T, Acc>>::save(ModelWriter& out, const BasicLinearRegression<T, Acc>& model)
+{
+    if (model.w.empty())
+    {
+        throw std::logic_error("LinearRegression is not fitted");
+    }
+    std::int64_t config[] = {static_cast<std::int64_t>(model.n_features_), model.n_jobs_};
+    out.begin_model(ModelType::linear_regression);
+    out.add(ModelField::config, std::span<const std::int64_t>(config));
+    out.add(ModelField::weights, std::span<const T>(model.w));
+    out.add(ModelField::bias, one_(model.b));
+}
+
+template <typename T, typename Acc>
+BasicLinearRegression<T, Acc> ModelSerializer<BasicLinearRegression<T, Acc>>::load(const MappedModels& in, std::size_t model)
+{
+    in.expect(model, ModelType::linear_regression);
+    auto config = in.section<std::int64_t>(model, ModelField::config, 2);
+    BasicLinearRegression<T, Acc> lr;
+    lr.n_features_ = size_(in, model, config[0]);
+    lr.n_jobs_ = n_jobs_(in, model, config[1]);
+    lr.predict_pool_ = LazyThreadPool(lr.n_jobs_);
+    lr.w = in.borrow<T>(model, ModelField::weights, lr.n_features_);
+    lr.b = in.section<T>(model, ModelField::bias, 1)[0];
+    return lr;
+}
+
+template <typename T, typename Acc>
+void ModelSerializer<BasicLogisticRegression<T, Acc>>::save(ModelWriter& out, const BasicLogisticRegression<T, Acc>& model)
+{
+    if (model.w.empty())
+    {
+        throw std::logic_error("LogisticRegression is not fitted");
+    }
+    std::int64_t config[] = {static_cast<std::int64_t>(model.n_features_), static_cast<std::int64_t>(model.multiclass_), model.n_jobs_};
+    out.begin_model(ModelType::logistic_regression);
+    out.add(ModelField::config, std::span<const std::int64_t>(config));
+    out.add(ModelField::weights, std::span<const T>(model.w));
+    out.add(ModelField::bias, std::span<const T>(model.b));
+    out.add(ModelField::labels, std::span<const int>(model.labels_));
+}
+
+template <typename T, typename Acc>
+BasicLogisticRegression<T, Acc> ModelSerializer<BasicLogisticRegression<T, Acc>>::load(const MappedModels& in, std::size_t model)
+{
+    in.expect(model, ModelType::logistic_regression);
+    auto config = in.section<std::int64_t>(model, ModelField::config, 3);
+    if (config[1] != static_cast<std::int64_t>(MultiClass::ovr) and config[1] != static_cast<std::int64_t>(MultiClass::multinomial))
+    {
+        in.corrupt(std::format("invalid multiclass {} in model {}", config[1], model));
+    }
+    BasicLogisticRegression<T, Acc> lr;
+    lr.n_features_ = size_(in, model, config[0]);
+    lr.multiclass_ = static_cast<MultiClass>(config[1]);
+    lr.n_jobs_ = n_jobs_(in, model, config[2]);
+    lr.predict_pool_ = LazyThreadPool(lr.n_jobs_);
+    lr.labels_ = in.copy<int>(model, ModelField::labels);
+    lr.b = in.borrow<T>(model, ModelField::bias);
+    //Binary ovr models have a single output, every other model one per class
+    if (lr.labels_.size() < 2 or (lr.b.size() != 1 and lr.b.size() != lr.labels_.size()) or (lr.b.size() == 1 and lr.labels_.size() != 2))
+    {
+        in.corrupt(std::format("inconsistent LogisticRegression {}", model));
+    }
+    lr.w = in.borrow<T>(model, ModelField::weights, lr.b.size()*lr.n_features_);
+    return lr;
+}
+
+template <typename T, typename Acc>
+void ModelSerializer<BasicZScoreNormalizer<T, Acc>>::save(ModelWriter& out, const BasicZScoreNormalizer<T, Acc>& model)
+{
+    if (model.n_samples_seen_ == 0)
+    {
+        throw std::logic_error("ZScoreNormalizer is not fitted");
+    }
+    std::int64_t config[] = {static_cast<std::int64_t>(model.n_samples_seen_), model.n_jobs_};
+    std::vector<double> moments;
+    for (auto [mean, m2]: model.moments_)
+    {
+        moments.insert(std::end(moments), {mean, m2});
+    }
+    out.begin_model(ModelType::zscore_normalizer);
+    out.add(ModelField::config, std::span<const std::int64_t>(config));
+    out.add(ModelField::moments, std::span<const double>(moments));
+    out.add(ModelField::scale, std::span<const Acc>(model.forward_.scale));
+    out.add(ModelField::shift, std::span<const Acc>(model.forward_.shift));
+    out.add(ModelField::inverse_scale, std::span<const Acc>(model.inverse_.scale));
+    out.add(ModelField::inverse_shift, std::span<const Acc>(model.inverse_.shift));
+}
+
+template <typename T, typename Acc>
+BasicZScoreNormalizer<T, Acc> ModelSerializer<BasicZScoreNormalizer<T, Acc>>::load(const MappedModels& in, std::size_t model)
+{
+    in.expect(model, ModelType::zscore_normalizer);
+    auto config = in.section<std::int64_t>(model, ModelField::config, 2);
+    auto moments = in.section<double>(model, ModelField::moments);
+    if (moments.size()%2 != 0)
+    {
+        in.corrupt(std::format("inconsistent ZScoreNormalizer {}", model));
+    }
+    std::size_t n_features = moments.size()/2;
+    if (config[0] <= 0)
+    {
+        in.corrupt(std::format("ZScoreNormalizer {} has seen no samples", model));
+    }
+    BasicZScoreNormalizer<T, Acc> normalizer(n_jobs_(in, model, config[1]));
+    normalizer.n_samples_seen_ = config[0];
+    for (std::size_t j=0; j<n_features; j++)
+    {
+        normalizer.moments_.push_back({moments[2*j], moments[2*j+1]});
+    }
+    normalizer.forward_ = {in.copy<Acc>(model, ModelField::scale, n_features), in.copy<Acc>(model, ModelField::shift, n_features)};
+    normalizer.inverse_ = {in.copy<Acc>(model, ModelField::inverse_scale, n_features), in.copy<Acc>(model, ModelField::inverse_shift, n_features)};
+    return normalizer;
+}
+
+void ModelSerializer<PolynomialFeatures>::save(ModelWriter& out, const PolynomialFeatures& model)
+{
+    if (model.n_features_ == 0)
+    {
+        throw std::logic_error("PolynomialFeatures is not fitted");
+    }
+    std::int64_t config[] = {model.degree_.first, model.degree_.second, model.interaction_only_, model.include_bias_, model.n_jobs_,
+        static_cast<std::int64_t>(model.n_features_), static_cast<std::int64_t>(model.n_features_out_), static_cast<std::int64_t>(model.n_full_),
+        static_cast<std::int64_t>(model.skip_)};
+    std::vector<std::uint32_t> plan;
+    for (const auto& run: model.plan_)
+    {
+        plan.insert(std::end(plan), {run.src, run.dst, run.length, run.feature});
+    }
+    out.begin_model(ModelType::polynomial_features);
+    out.add(ModelField::config, std::span<const std::int64_t>(config));
+    out.add(ModelField::plan, std::span<const std::uint32_t>(plan));
+}
+
+PolynomialFeatures ModelSerializer<PolynomialFeatures>::load(const MappedModels& in, std::size_t model)
+{
+    in.expect(model, ModelType::polynomial_features);
+    auto config = in.section<std::int64_t>(model, ModelField::config, 9);
+    auto plan = in.section<std::uint32_t>(model, ModelField::plan);
+    if (config[0] < 0 or config[0] > config[1] or config[1] > MAX_COMBINATION_SIZE)
+    {
+        in.corrupt(std::format("invalid degrees ({}, {}) in model {}", config[0], config[1], model));
+    }
+    PolynomialFeatures poly(std::pair<int, int>(config[0], config[1]), flag_(in, model, config[2]), flag_(in, model, config[3]));
+    poly.n_jobs_ = n_jobs_(in, model, config[4]);
+    poly.pool_ = LazyThreadPool(poly.n_jobs_);
+    poly.n_features_ = size_(in, model, config[5]);
+    poly.n_features_out_ = size_(in, model, config[6]);
+    poly.n_full_ = size_(in, model, config[7]);
+    poly.skip_ = size_(in, model, config[8]);
+    //The plan is trusted as is, so check that it stays inside the input row, the scratch and the output row
+    bool valid = plan.size()%4 == 0 and poly.skip_ <= poly.n_full_ and poly.n_features_out_ >= poly.include_bias_ and
+        poly.n_full_-poly.skip_ == poly.n_features_out_-poly.include_bias_;
+    for (std::size_t k=0; valid and k<plan.size(); k+=4)
+    {
+        detail::PolynomialRun run{plan[k], plan[k+1], plan[k+2], plan[k+3]};
+        bool copy = run.feature == detail::POLYNOMIAL_COPY;
+        valid = std::uint64_t{run.dst}+run.length <= poly.n_full_ and
+            std::uint64_t{run.src}+run.length <= (copy? poly.n_features_:poly.n_full_) and (copy or run.feature < poly.n_features_);
+        poly.plan_.push_back(run);
+    }
+    if (not valid)
+    {
+        in.corrupt(std::format("inconsistent PolynomialFeatures {}", model));
+    }
+    return poly;
+}
+
+#define MLPP_INSTANTIATE_SERIALIZERS_(T, Acc) \
+    template struct ModelSerializer<BasicLinearRegression<T, Acc>>; \
+    template struct ModelSerializer<BasicLogisticRegression<T, Acc>>; \
+    template struct ModelSerializer<BasicZScoreNormalizer<T, Acc>>;
+MLPP_FOR_EACH_SCALAR(MLPP_INSTANTIATE_SERIALIZERS_)
+}// namespace ML
@@ -0,0 +1,232 @@
+#include <profiling.hpp>
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace ML::profiling
+{
+/**********
+* PRIVATE *
+**********/
+namespace
+{
+thread_local std::uint64_t allocations_ = 0;
+
+struct Event
+{
+    const char* name;
+    std::uint64_t start_ns, duration_ns;
+    std::uint64_t rows, bytes, allocations;
+};
+struct IterationEvent
+{
+    const char* solver;
+    std::uint64_t time_ns;
+    float gradient_norm, loss;
+};
+
+// Every thread records into its own buffer, so the lock is only ever contended while exporting
+struct ThreadBuffer
+{
+    std::mutex mutex;
+    std::size_t tid;
+    std::vector<Event> events;
+    std::vector<IterationEvent> iterations;
+};
+
+struct Profiler
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers; //Kept after their thread exits, until the next start()
+    std::uint64_t start_ns = 0;
+    //Copied by the solver threads on every iteration while another thread may replace it, under its own lock so
+    //iterations never wait for an export
+    std::mutex callback_mutex;
+    std::shared_ptr<const std::function<void(const IterationInfo&)>> iteration_callback;
+};
+Profiler& profiler_()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+ThreadBuffer& thread_buffer_()
+{
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr)
+    {
+        Profiler& p = profiler_();
+        std::scoped_lock lock(p.mutex);
+        p.buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = p.buffers.back().get();
+        buffer->tid = p.buffers.size();
+    }
+    return *buffer;
+}
+
+std::string json_string_(const char* s)
+{
+    std::string out = "\"";
+    for (; *s != '\0'; s++)
+    {
+        if (*s == '"' or *s == '\\')
+        {
+            out += '\\';
+        }
+        out += *s;
+    }
+    return out + "\"";
+}
+}// namespace
+
+std::uint64_t detail::thread_allocations()
+{
+    return allocations_;
+}
+
+void detail::count_allocation()
+{
+    allocations_++;
+}
+
+void detail::record_scope(const char* name, std::uint64_t start_ns, std::uint64_t end_ns, std::uint64_t rows, std::uint64_t bytes, std::uint64_t allocations)
+{
+    ThreadBuffer& buffer = thread_buffer_();
+    std::scoped_lock lock(buffer.mutex);
+    buffer.events.push_back({name, start_ns, end_ns-start_ns, rows, bytes, allocations});
+}
+
+/*********
+* PUBLIC *
+*********/
+void start()
+{
+    Profiler& p = profiler_();
+    std::scoped_lock lock(p.mutex);
+    for (auto& buffer: p.buffers)
+    {
+        std::scoped_lock buffer_lock(buffer->mutex);
+        buffer->events.clear();
+        buffer->iterations.clear();
+    }
+    p.start_ns = detail::now_ns();
+    detail::recording.store(true);
+}
+
+void stop()
+{
+    detail::recording.store(false);
+}
+
+void set_iteration_callback(std::function<void(const IterationInfo&)> callback)
+{
+    auto shared = callback? std::make_shared<const std::function<void(const IterationInfo&)>>(std::move(callback)):nullptr;
+    Profiler& p = profiler_();
+    std::scoped_lock lock(p.callback_mutex);
+    p.iteration_callback = std::move(shared);
+}
+
+void iteration(const IterationInfo& info)
+{
+    if (detail::recording.load(std::memory_order_relaxed))
+    {
+        ThreadBuffer& buffer = thread_buffer_();
+        std::scoped_lock lock(buffer.mutex);
+        buffer.iterations.push_back({info.solver, detail::now_ns(), info.gradient_norm, info.loss});
+    }
+    //Kept alive by this copy if the callback is replaced while it runs
+    std::shared_ptr<const std::function<void(const IterationInfo&)>> callback;
+    {
+        Profiler& p = profiler_();
+        std::scoped_lock lock(p.callback_mutex);
+        callback = p.iteration_callback;
+    }
+    if (callback)
+    {
+        (*callback)(info);
+    }
+}
+
+std::vector<Summary> summary()
+{
+    Profiler& p = profiler_();
+    std::scoped_lock lock(p.mutex);
+    std::map<std::string, Summary> totals;
+    for (auto& buffer: p.buffers)
+    {
+        std::scoped_lock buffer_lock(buffer->mutex);
+        for (const Event& e: buffer->events)
+        {
+            Summary& s = totals[e.name];
+            s.calls++;
+            s.seconds += e.duration_ns*1e-9;
+            s.rows += e.rows;
+            s.bytes += e.bytes;
+            s.allocations += e.allocations;
+        }
+        for (const IterationEvent& e: buffer->iterations)
+        {
+            totals[e.solver].iterations++;
+        }
+    }
+    std::vector<Summary> result;
+    for (auto& [name, s]: totals)
+    {
+        s.name = name;
+        result.push_back(std::move(s));
+    }
+    return result;
+}
+
+void write_chrome_trace(const std::string& path)
+{
+    std::vector<Summary> totals = summary();
+    std::ofstream file(path);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    {
+        Profiler& p = profiler_();
+        std::scoped_lock lock(p.mutex);
+        bool first = true;
+        auto us = [&p](std::uint64_t ns) { return (ns-std::min(ns, p.start_ns))*1e-3; };
+        for (auto& buffer: p.buffers)
+        {
+            std::scoped_lock buffer_lock(buffer->mutex);
+            for (const Event& e: buffer->events)
+            {
+                file << std::format("{}{{\"name\": {}, \"cat\": \"MLPP\", \"ph\": \"X\", \"ts\": {:.3f}, \"dur\": {:.3f}, \"pid\": 1, \"tid\": {}, "
+                    "\"args\": {{\"rows\": {}, \"bytes\": {}, \"allocations\": {}}}}}", first? "":",\n", json_string_(e.name), us(e.start_ns),
+                    e.duration_ns*1e-3, buffer->tid, e.rows, e.bytes, e.allocations);
+                first = false;
+            }
+            for (const IterationEvent& e: buffer->iterations)
+            {
+                std::string args = std::format("\"gradient_norm\": {}", e.gradient_norm);
+                if (not std::isnan(e.loss))
+                {
+                    args += std::format(", \"loss\": {}", e.loss);
+                }
+                file << std::format("{}{{\"name\": {}, \"cat\": \"MLPP\", \"ph\": \"C\", \"ts\": {:.3f}, \"pid\": 1, \"tid\": {}, \"args\": {{{}}}}}",
+                    first? "":",\n", json_string_(e.solver), us(e.time_ns), buffer->tid, args);
+                first = false;
+            }
+        }
+    }
+    file << "\n], \"otherData\": {\"summary\": [";
+    for (std::size_t k=0; k<totals.size(); k++)
+    {
+        const Summary& s = totals[k];
+        file << std::format("{}\n  {{\"name\": {}, \"calls\": {}, \"seconds\": {}, \"rows\": {}, \"bytes\": {}, \"allocations\": {}, \"iterations\": {}}}",
+            k? ",":"", json_string_(s.name.c_str()), s.calls, s.seconds, s.rows, s.bytes, s.allocations, s.iterations);
+    }
+    file << "\n]}}\n";
+    if (not file)
+    {
+        throw std::runtime_error(std::format("Could not write {}", path));
+    }
+}
+}// namespace ML::profiling
@@ -0,0 +1,110 @@
+#include <threadpool.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace ML
+{
+size_t effective_n_jobs(int n_jobs)
+{
+    if (n_jobs == 0)
+    {
+        throw std::invalid_argument("n_jobs == 0 has no meaning, use a positive value or -1 for all cores");
+    }
+    if (n_jobs > 0)
+    {
+        return n_jobs;
+    }
+    int n_cores = std::max(1u, std::thread::hardware_concurrency());
+    return std::max(1, n_cores+1+n_jobs);
+}
+
+/**********
+* PRIVATE *
+**********/
+void ThreadPool::work_()
+{
+    for (size_t i=next_task_++; i<n_tasks_; i=next_task_++)
+    {
+        task_(ctx_, i);
+    }
+}
+
+void ThreadPool::worker_loop_()
+{
+    size_t seen_generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock lock(mutex_);
+            start_cv_.wait(lock, [&] { return stop_ or generation_ != seen_generation; });
+            if (stop_) return;
+            seen_generation = generation_;
+        }
+        work_();
+        std::lock_guard lock(mutex_);
+        if (--busy_ == 0)
+        {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run_(size_t n_tasks, void* ctx, Task task)
+{
+    std::lock_guard run_lock(run_mutex_);
+    {
+        std::lock_guard lock(mutex_);
+        ctx_ = ctx;
+        task_ = task;
+        n_tasks_ = n_tasks;
+        next_task_ = 0;
+        busy_ = workers_.size();
+        generation_++;
+    }
+    start_cv_.notify_all();
+    work_();
+    std::unique_lock lock(mutex_);
+    done_cv_.wait(lock, [this] { return busy_ == 0; });
+}
+
+ThreadPool& LazyThreadPool::pool_() const
+{
+    std::call_once(state_->started, [this] { state_->pool = std::make_unique<ThreadPool>(state_->n_threads); });
+    return *state_->pool;
+}
+
+/*********
+* PUBLIC *
+*********/
+ThreadPool::ThreadPool(size_t n_threads)
+{
+    if (n_threads > 1)
+    {
+        workers_.reserve(n_threads-1);
+        for (size_t i=1; i<n_threads; i++)
+        {
+            workers_.emplace_back([this] { worker_loop_(); });
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    workers_.clear(); //Join before the mutex and condition variables are destroyed
+}
+
+LazyThreadPool::LazyThreadPool(int n_jobs)
+{
+    size_t n_threads = effective_n_jobs(n_jobs);
+    if (n_threads > 1)
+    {
+        state_ = std::make_shared<State_>();
+        state_->n_threads = n_threads;
+    }
+}
+}// namespace ML
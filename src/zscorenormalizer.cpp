@@ -1,77 +1,273 @@
 #include <zscorenormalizer.hpp>
+#include <threadpool.hpp>
+#include <profiling.hpp>
+#include <format>
+#include <stdexcept>
 namespace ML
 {
 /**********
 * PRIVATE *
 **********/
-constexpr float ZScoreNormalizer::norm_sample(float value, size_t feature) const
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::check_shapes_(const Affine& f, std::pair<size_t, size_t> in, std::pair<size_t, size_t> out)
 {
-    return (value-stats_[feature].mean)/stats_[feature].stddev;
+    if (f.scale.empty())
+    {
+        throw std::logic_error("ZScoreNormalizer is not fitted");
+    }
+    if (in.second != f.scale.size())
+    {
+        throw std::invalid_argument(std::format("X has {} features, but ZScoreNormalizer was fitted with {}", in.second, f.scale.size()));
+    }
+    if (out != in)
+    {
+        throw std::invalid_argument(std::format("out has shape ({}, {}) for X of shape ({}, {})", out.first, out.second, in.first, in.second));
+    }
 }
-constexpr float ZScoreNormalizer::inv_norm_sample(float norm_value, size_t feature) const
+
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::apply_(const Affine& f, Array2DView<const T> in, Array2DView<T> out) const
 {
-    return norm_value*stats_[feature].stddev + stats_[feature].mean;
+    MLPP_PROFILE_DATA_SCOPE(&f == &forward_? "ZScoreNormalizer::transform":"ZScoreNormalizer::inverse_transform", in.size(), 2*in.size()*in.shape().second*sizeof(T));
+    check_shapes_(f, in.shape(), out.shape());
+    size_t n_features = f.scale.size();
+    const Acc* scale = f.scale.data();
+    const Acc* shift = f.shift.data();
+    //Row by row, so the matrix is streamed once, with a multiply-add per element the compiler can vectorize
+    for (size_t r=0; r<in.size(); r++)
+    {
+        const T* x = in[r].data();
+        T* y = out[r].data();
+        for (size_t j=0; j<n_features; j++)
+        {
+            y[j] = static_cast<T>(x[j]*scale[j] + shift[j]);
+        }
+    }
 }
 
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::apply_(const Affine& f, const ColumnMajorArray2D<T>& in, ColumnMajorArray2D<T>& out) const
+{
+    MLPP_PROFILE_DATA_SCOPE(&f == &forward_? "ZScoreNormalizer::transform":"ZScoreNormalizer::inverse_transform", in.size(), 2*in.size()*in.shape().second*sizeof(T));
+    check_shapes_(f, in.shape(), out.shape());
+    for (size_t j=0; j<f.scale.size(); j++)
+    {
+        ranges::transform(in[][j], std::begin(out[][j]), [scale = f.scale[j], shift = f.shift[j]](T x) { return static_cast<T>(x*scale + shift); });
+    }
+}
 
-constexpr void ZScoreNormalizer::update_feature_stats(const Array2D<float>& X, size_t feature)
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::reset_()
 {
-    float average = 0.f;
-    for (auto r: X)
+    n_samples_seen_ = 0;
+    moments_.clear();
+    forward_ = {};
+    inverse_ = {};
+}
+
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::check_features_(size_t n_features)
+{
+    if (n_samples_seen_ == 0)
     {
-       average += r[feature];
+        moments_.assign(n_features, {});
     }
+    else if (n_features != moments_.size())
+    {
+        throw std::invalid_argument(std::format("X has {} features, but ZScoreNormalizer was fitted with {}", n_features, moments_.size()));
+    }
+}
 
-    average /= X.size();
-    float std_dev = 0.f;
-    for (auto r: X)
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::merge_moments_(std::span<const Moments> b, size_t n_b)
+{
+    size_t n_a = n_samples_seen_;
+    double n = n_a + n_b;
+    for (auto&& [a_j, b_j]: std::views::zip(moments_, b))
+    {
+        double delta = b_j.mean - a_j.mean;
+        a_j.mean += delta*(n_b/n);
+        a_j.m2 += b_j.m2 + delta*delta*(n_a*(n_b/n));
+    }
+    n_samples_seen_ += n_b;
+}
+
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::update_stats_()
+{
+    size_t n_features = moments_.size();
+    for (Affine* f: {&forward_, &inverse_})
+    {
+        f->scale.resize(n_features);
+        f->shift.resize(n_features);
+    }
+    for (size_t j=0; j<n_features; j++)
     {
-       std_dev += (r[feature]-average)*(r[feature]-average);
+        double mean = moments_[j].mean, stddev = std::sqrt(moments_[j].m2/n_samples_seen_);
+        forward_.scale[j] = static_cast<Acc>(1/stddev);
+        forward_.shift[j] = static_cast<Acc>(-mean/stddev);
+        inverse_.scale[j] = static_cast<Acc>(stddev);
+        inverse_.shift[j] = static_cast<Acc>(mean);
     }
-    std_dev = std::sqrt(std_dev/X.size());
-    /*namespace ranges = std::ranges;
-    float average = ranges::fold_left(X, 0.f, [feature](float prev, const Row<T>& x){ return prev+x[feature]; });
-    float std_dev = std::sqrt(ranges::fold_left(X, 0.f, [feature, average](float prev, const Row<T>& x) { return prev + (x[feature] - average)*(x[feature] - average); }));
-    */
-    stats_[feature] = Statistics{average, std_dev};
 }
 
 /*********
 * PUBLIC *
 *********/
-ZScoreNormalizer& ZScoreNormalizer::fit(const Array2D<float>& X)
-{   
-    auto n_features = X[0].size();
-    stats_.resize(n_features);
+template <typename T, typename Acc>
+BasicZScoreNormalizer<T, Acc>::BasicZScoreNormalizer(int n_jobs):
+    n_jobs_(n_jobs),
+    pool_(n_jobs)
+{}
 
-    for (size_t i=0; i<n_features; i++)
-    {
-        update_feature_stats(X, i);
-    }
-    return *this;
+template <typename T, typename Acc>
+BasicZScoreNormalizer<T, Acc>& BasicZScoreNormalizer<T, Acc>::fit(Array2DView<const T> X)
+{
+    reset_();
+    return partial_fit(X);
 }
 
-Array2D<float> ZScoreNormalizer::transform(const Array2D<float>& X_) const
+template <typename T, typename Acc>
+BasicZScoreNormalizer<T, Acc>& BasicZScoreNormalizer<T, Acc>::fit(const ColumnMajorArray2D<T>& X)
 {
-    Array2D<float> X = X_; //Explicit copy to enable NRVO (instead of receiving parameter by value)
-    for (size_t i=0; i<stats_.size(); i++)
+    reset_();
+    return partial_fit(X);
+}
+
+template <typename T, typename Acc>
+BasicZScoreNormalizer<T, Acc>& BasicZScoreNormalizer<T, Acc>::partial_fit(Array2DView<const T> X)
+{
+    MLPP_PROFILE_DATA_SCOPE("ZScoreNormalizer::partial_fit", X.size(), X.size()*X.shape().second*sizeof(T));
+    size_t n_samples = X.size();
+    if (n_samples == 0)
+    {
+        return *this;
+    }
+    size_t n_features = X[0].size();
+    check_features_(n_features);
+
+    //Every shard runs Welford's update over its rows, all features of a row at once
+    size_t n_shards = (n_samples+SHARD_ROWS-1)/SHARD_ROWS;
+    std::vector<Moments> shard_moments(n_shards*n_features);
+    pool_.parallel_for(n_shards, [&](size_t shard)
     {
-        for (auto v: X)
+        size_t first = shard*SHARD_ROWS, last = std::min(first+SHARD_ROWS, n_samples);
+        Moments* m = shard_moments.data()+shard*n_features;
+        for (size_t i=first; i<last; i++)
         {
-            v[i] = norm_sample(v[i], i);
+            const T* x = X[i].data();
+            double inv_count = 1./(i-first+1);
+            for (size_t j=0; j<n_features; j++)
+            {
+                double x_j = static_cast<double>(x[j]);
+                double delta = x_j - m[j].mean;
+                m[j].mean += delta*inv_count;
+                m[j].m2 += delta*(x_j - m[j].mean);
+            }
         }
+    });
+    //In shard order, so the result does not depend on the number of threads
+    for (size_t shard=0; shard<n_shards; shard++)
+    {
+        size_t rows = std::min(SHARD_ROWS, n_samples-shard*SHARD_ROWS);
+        merge_moments_(std::span(shard_moments.data()+shard*n_features, n_features), rows);
     }
-    return X;
+    update_stats_();
+    return *this;
 }
 
-void ZScoreNormalizer::inverse_transform(Array2D<float>& X) const
+template <typename T, typename Acc>
+BasicZScoreNormalizer<T, Acc>& BasicZScoreNormalizer<T, Acc>::partial_fit(const ColumnMajorArray2D<T>& X)
 {
-    for (size_t i=0; i<stats_.size(); i++)
+    MLPP_PROFILE_DATA_SCOPE("ZScoreNormalizer::partial_fit", X.size(), X.size()*X.shape().second*sizeof(T));
+    size_t n_samples = X.size();
+    if (n_samples == 0)
+    {
+        return *this;
+    }
+    size_t n_features = X[0].size();
+    check_features_(n_features);
+
+    //Features are independent and contiguous, one Welford pass per feature
+    std::vector<Moments> chunk_moments(n_features);
+    pool_.parallel_for(n_features, [&](size_t j)
     {
-        for (auto v: X)
+        Moments m;
+        size_t count = 0;
+        for (T v: X[][j])
         {
-            v[i] = inv_norm_sample(v[i], i);
+            double x = static_cast<double>(v);
+            double delta = x - m.mean;
+            m.mean += delta/++count;
+            m.m2 += delta*(x - m.mean);
         }
-    }
+        chunk_moments[j] = m;
+    });
+    merge_moments_(chunk_moments, n_samples);
+    update_stats_();
+    return *this;
 }
+
+template <typename T, typename Acc>
+Array2D<T> BasicZScoreNormalizer<T, Acc>::transform(Array2DView<const T> X) const
+{
+    Array2D<T> XN(X.size(), X.shape().second);
+    apply_(forward_, X, XN);
+    return XN;
+}
+
+template <typename T, typename Acc>
+ColumnMajorArray2D<T> BasicZScoreNormalizer<T, Acc>::transform(const ColumnMajorArray2D<T>& X) const
+{
+    ColumnMajorArray2D<T> XN(X.size(), X.shape().second);
+    apply_(forward_, X, XN);
+    return XN;
+}
+
+template <typename T, typename Acc>
+Array2D<T> BasicZScoreNormalizer<T, Acc>::transform(Array2D<T>&& X) const
+{
+    transform_inplace(X);
+    return std::move(X);
+}
+
+template <typename T, typename Acc>
+ColumnMajorArray2D<T> BasicZScoreNormalizer<T, Acc>::transform(ColumnMajorArray2D<T>&& X) const
+{
+    transform_inplace(X);
+    return std::move(X);
+}
+
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::transform_inplace(Array2DView<T> X) const
+{
+    apply_(forward_, X, X);
+}
+
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::transform_inplace(ColumnMajorArray2D<T>& X) const
+{
+    apply_(forward_, X, X);
+}
+
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::transform_into(Array2DView<const T> X, Array2DView<T> out) const
+{
+    apply_(forward_, X, out);
+}
+
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::inverse_transform(Array2DView<T> X) const
+{
+    apply_(inverse_, X, X);
+}
+
+template <typename T, typename Acc>
+void BasicZScoreNormalizer<T, Acc>::inverse_transform(ColumnMajorArray2D<T>& X) const
+{
+    apply_(inverse_, X, X);
+}
+
+#define MLPP_INSTANTIATE_ZSCORE_(T, Acc) template class BasicZScoreNormalizer<T, Acc>;
+MLPP_FOR_EACH_SCALAR(MLPP_INSTANTIATE_ZSCORE_)
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include <array2D.hpp>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <source_location>
+#include <span>
+
+// Minimal checks for the test executables: a failed check is reported with its location and makes the test fail
+// through ML::test::exit_code(), which main returns.
+namespace ML::test
+{
+inline int failures = 0;
+
+inline void check(bool ok, const char* what, std::source_location where = std::source_location::current())
+{
+    if (not ok)
+    {
+        std::fprintf(stderr, "%s:%u: check failed: %s\n", where.file_name(), static_cast<unsigned>(where.line()), what);
+        failures++;
+    }
+}
+
+// Same object representation, so NaNs and signed zeros have to match too
+template <typename T>
+bool bitwise_equal(std::span<const T> a, std::span<const T> b)
+{
+    return a.size() == b.size() and (a.empty() or std::memcmp(a.data(), b.data(), a.size_bytes()) == 0);
+}
+
+// Reproducible features drawn uniformly from [low, high)
+inline Array2D<float> random_matrix(std::size_t n_samples, std::size_t n_features, unsigned seed, float low = -1.f, float high = 1.f)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(low, high);
+    Array2D<float> X(n_samples, n_features);
+    for (auto row: X)
+    {
+        for (float& x: row)
+        {
+            x = uniform(rng);
+        }
+    }
+    return X;
+}
+
+inline int exit_code()
+{
+    if (failures > 0)
+    {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+    }
+    return failures > 0;
+}
+}// namespace ML::test
+
+#define MLPP_CHECK(...) ML::test::check(static_cast<bool>(__VA_ARGS__), #__VA_ARGS__)
@@ -0,0 +1,189 @@
+#include <mlcommons.hpp>
+#include <linearregression.hpp>
+#include <logsticregression.hpp>
+#include <zscorenormalizer.hpp>
+#include <polynomialfeatures.hpp>
+#include <pipeline.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <vector>
+#include "check.hpp"
+
+// The steady state of training and serving must not touch the heap: gradient functions called on a warm gradient,
+// solver iterations, transform_into and predict_into (threaded or through a Pipeline) all reuse buffers allocated once.
+// Allocations of every thread are counted by replacing the global operator new.
+using namespace ML;
+
+namespace
+{
+std::atomic<std::size_t> allocations_ = 0;
+}// namespace
+std::size_t allocations()
+{
+    return allocations_.load();
+}
+#if defined(__GNUC__) and not defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" //GCC takes free() in a replacement operator delete for a mismatch
+#endif
+void* operator new(std::size_t size)
+{
+    allocations_++;
+    if (void* p = std::malloc(size == 0? 1:size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    allocations_++;
+    std::size_t align = static_cast<std::size_t>(alignment);
+    if (void* p = std::aligned_alloc(align, (std::max<std::size_t>(size, 1)+align-1)/align*align))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+// Heap allocations made by f
+template <typename F>
+std::size_t count_allocations(F f)
+{
+    std::size_t before = allocations();
+    f();
+    return allocations()-before;
+}
+
+void test_gradient_functions(const Array2D<float>& X, const std::vector<float>& y, const std::vector<std::size_t>& y_idx)
+{
+    std::size_t n_features = X[0].size(), n_classes = 3;
+    std::vector<float> w(n_features, 0.1f), w_multi(n_classes*n_features, 0.1f), b_multi(n_classes, 0.f);
+    std::vector<std::size_t> rows = {0, 3, 5, 8};
+
+    Gradient grad(n_features, true);
+    linear_cost_gradient(X, y, w, 0.f, grad);
+    MLPP_CHECK(count_allocations([&]
+    {
+        linear_cost_gradient(X, y, w, 0.f, grad);
+        linear_cost_gradient(X, y, w, 0.f, grad, 0, X.size()/2);
+        linear_cost_gradient(X, y, w, 0.f, grad, rows);
+        log_cost_gradient(X, y, w, 0.f, grad);
+    }) == 0);
+
+    MultiGradient multi_grad(n_features, true, n_classes);
+    OvRLogCostGradient ovr{n_classes};
+    SoftmaxCostGradient softmax{n_classes};
+    ovr(X, y_idx, w_multi, b_multi, multi_grad);
+    MLPP_CHECK(count_allocations([&]
+    {
+        ovr(X, y_idx, w_multi, b_multi, multi_grad);
+        softmax(X, y_idx, w_multi, b_multi, multi_grad);
+        softmax(X, y_idx, w_multi, b_multi, multi_grad, rows);
+    }) == 0);
+}
+
+// The iterations themselves do not allocate: a fit costs the same allocations whatever the number of iterations
+void test_solver_iterations(const Array2D<float>& X, const std::vector<float>& y)
+{
+    constexpr StoppingParams FIXED_ITERS = {.criterion=StoppingCriterion::none};
+    for (int n_jobs: {1, 2})
+    {
+        std::size_t few = count_allocations([&] { gradient_descent(X, y, 0.01f, 5, linear_cost_gradient, n_jobs, FIXED_ITERS); });
+        std::size_t many = count_allocations([&] { gradient_descent(X, y, 0.01f, 200, linear_cost_gradient, n_jobs, FIXED_ITERS); });
+        MLPP_CHECK(few == many);
+    }
+}
+
+void test_transform_into(const Array2D<float>& X)
+{
+    ZScoreNormalizer normalizer;
+    normalizer.fit(X);
+    Array2D<float> XN(X.size(), X[0].size());
+    MLPP_CHECK(count_allocations([&] { normalizer.transform_into(X, XN); }) == 0);
+
+    //min_degree 2 builds the degree 1 columns in scratch
+    for (auto degree: {std::pair(0, 2), std::pair(2, 2)})
+    {
+        PolynomialFeatures poly(degree);
+        poly.fit(X);
+        Array2D<float> XP(X.size(), poly.n_features_out());
+        std::vector<float> scratch(poly.scratch_size());
+        MLPP_CHECK(count_allocations([&] { poly.transform_into<float>(X, XP, scratch); }) == 0);
+    }
+}
+
+void test_predict_into(const Array2D<float>& X, const std::vector<float>& y, const std::vector<int>& labels)
+{
+    std::vector<float> y_pred(X.size());
+    std::vector<int> labels_pred(X.size());
+    //n_jobs = 2 on a batch large enough to be split over the predict pool, which the first call starts
+    for (int n_jobs: {1, 2})
+    {
+        LinearRegression lr({.n_jobs=n_jobs, .solver=Solver::normal_equations});
+        lr.fit(X, y);
+        lr.predict_into(X, y_pred);
+        MLPP_CHECK(count_allocations([&] { lr.predict_into(X, y_pred); }) == 0);
+
+        LogisticRegression clf({.max_iter=20, .multiclass=MultiClass::multinomial, .n_jobs=n_jobs, .solver=Solver::lbfgs});
+        clf.fit(X, labels);
+        clf.predict_into(X, labels_pred);
+        MLPP_CHECK(count_allocations([&] { clf.predict_into(X, labels_pred); }) == 0);
+    }
+
+    //The chunk buffers are allocated by the first call and reused by the next ones, score included, whether they are
+    //the Pipeline's own or those of a caller's Workspace
+    for (auto degree: {std::pair(0, 2), std::pair(2, 2)})
+    {
+        Pipeline pipe(ZScoreNormalizer(), PolynomialFeatures(degree), LinearRegression({.solver=Solver::normal_equations}));
+        pipe.fit(X, y);
+        pipe.predict_into(X, std::span(y_pred));
+        MLPP_CHECK(count_allocations([&] { pipe.predict_into(X, std::span(y_pred)); }) == 0);
+        MLPP_CHECK(count_allocations([&] { (void)pipe.score(X, y); }) == 0);
+
+        decltype(pipe)::Workspace workspace;
+        pipe.predict_into(X, std::span(y_pred), workspace);
+        MLPP_CHECK(count_allocations([&] { pipe.predict_into(X, std::span(y_pred), workspace); }) == 0);
+    }
+}
+}// namespace
+
+int main()
+{
+    //Enough rows*features for predict to go parallel, see detail::PARALLEL_PREDICT_MIN_ELEMENTS
+    Array2D<float> X = test::random_matrix(20000, 16, 7);
+    std::vector<float> y(X.size());
+    std::vector<std::size_t> y_idx(X.size());
+    std::vector<int> labels(X.size());
+    for (std::size_t i=0; i<X.size(); i++)
+    {
+        y[i] = 2.f*X[i][0] - X[i][1] + 0.5f;
+        y_idx[i] = (X[i][2] > 0) + (X[i][3] > 0);
+        labels[i] = static_cast<int>(y_idx[i]);
+    }
+    test_gradient_functions(X, y, y_idx);
+    test_solver_iterations(X, y);
+    test_transform_into(X);
+    test_predict_into(X, y, labels);
+    return test::exit_code();
+}
@@ -0,0 +1,212 @@
+#include <modelfile.hpp>
+#include <linearregression.hpp>
+#include <logsticregression.hpp>
+#include <zscorenormalizer.hpp>
+#include <polynomialfeatures.hpp>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "check.hpp"
+
+// Save -> MappedModels -> load round trips of every model type: the loaded model has to predict (or transform) exactly
+// the same bits as the one that was saved. Then damaged files have to be rejected when they are opened or loaded.
+using namespace ML;
+
+namespace
+{
+const std::string PATH = (std::filesystem::temp_directory_path() / "mlpp_test_modelfile.mlpp").string();
+
+template <typename Model>
+Model round_trip(const Model& model)
+{
+    save_models(PATH, model);
+    return MappedModels(PATH).load<Model>();
+}
+
+template <typename T>
+bool same_bits(const std::vector<T>& a, const std::vector<T>& b)
+{
+    return test::bitwise_equal<T>(a, b);
+}
+bool same_bits(const Array2D<float>& a, const Array2D<float>& b)
+{
+    return a.shape() == b.shape() and test::bitwise_equal<float>(std::span(a.data(), a.size()*a.leading_dimension()), std::span(b.data(), b.size()*b.leading_dimension()));
+}
+
+void test_linear_regression(const Array2D<float>& X)
+{
+    std::vector<float> y(X.size());
+    for (std::size_t i=0; i<X.size(); i++)
+    {
+        y[i] = 3.f*X[i][0] - 2.f*X[i][2] + 0.5f;
+    }
+    LinearRegression lr({.solver=Solver::normal_equations});
+    lr.fit(X, y);
+    LinearRegression loaded = round_trip(lr);
+    MLPP_CHECK(same_bits(lr.predict(X), loaded.predict(X)));
+}
+
+void test_logistic_regression(const Array2D<float>& X, std::size_t n_classes, MultiClass multiclass)
+{
+    std::vector<int> y(X.size());
+    for (std::size_t i=0; i<X.size(); i++)
+    {
+        y[i] = static_cast<int>(static_cast<std::size_t>(std::abs(X[i][1]*2.f)) % n_classes);
+    }
+    LogisticRegression lr({.max_iter=50, .multiclass=multiclass, .solver=Solver::lbfgs});
+    lr.fit(X, y);
+    LogisticRegression loaded = round_trip(lr);
+    MLPP_CHECK(same_bits(lr.predict(X), loaded.predict(X)));
+    MLPP_CHECK(same_bits(lr.predict_proba(X), loaded.predict_proba(X)));
+}
+
+void test_zscore_normalizer(const Array2D<float>& X)
+{
+    ZScoreNormalizer normalizer;
+    normalizer.fit(X);
+    ZScoreNormalizer loaded = round_trip(normalizer);
+    MLPP_CHECK(same_bits(normalizer.transform(X), loaded.transform(X)));
+}
+
+void test_polynomial_features(const Array2D<float>& X)
+{
+    for (auto degree: {std::pair(0, 2), std::pair(2, 3)})
+    {
+        for (bool interaction_only: {false, true})
+        {
+            PolynomialFeatures poly(degree, interaction_only, true);
+            poly.fit(X);
+            PolynomialFeatures loaded = round_trip(poly);
+            MLPP_CHECK(same_bits(poly.transform(X), loaded.transform(X)));
+        }
+    }
+}
+
+template <typename F>
+bool throws_runtime_error(F f)
+{
+    try
+    {
+        f();
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+    return false;
+}
+
+std::vector<char> read_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+void write_file(const std::string& path, const std::vector<char>& bytes)
+{
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size());
+}
+
+void test_damaged_files(const Array2D<float>& X)
+{
+    LinearRegression lr({.solver=Solver::normal_equations});
+    lr.fit(X, std::vector<float>(X.size(), 1.f));
+    save_models(PATH, lr);
+    const std::vector<char> good = read_file(PATH);
+    MLPP_CHECK(good.size() > sizeof(ModelHeader));
+    auto load = [] { return MappedModels(PATH).load<LinearRegression>(); };
+
+    //Truncated: the sections run past the end of the file
+    write_file(PATH, std::vector<char>(std::begin(good), std::begin(good)+good.size()/2));
+    MLPP_CHECK(throws_runtime_error(load));
+    write_file(PATH, std::vector<char>(std::begin(good), std::begin(good)+sizeof(ModelHeader)/2));
+    MLPP_CHECK(throws_runtime_error(load));
+
+    //Not a model file
+    std::vector<char> bad = good;
+    bad[0] ^= 0x20;
+    write_file(PATH, bad);
+    MLPP_CHECK(throws_runtime_error(load));
+
+    //A section table entry pointing outside the file
+    bad = good;
+    auto* header = reinterpret_cast<ModelHeader*>(bad.data());
+    auto* sections = reinterpret_cast<ModelSection*>(bad.data()+header->sections_offset);
+    sections[0].offset = good.size();
+    write_file(PATH, bad);
+    MLPP_CHECK(throws_runtime_error(load));
+
+    //Valid file of another model type
+    write_file(PATH, good);
+    MLPP_CHECK(throws_runtime_error([] { return MappedModels(PATH).load<ZScoreNormalizer>(); }));
+}
+
+// Saves model, overwrites entry k of its config section with value and checks that loading it is rejected
+template <typename Model>
+bool rejects_config(const Model& model, std::size_t k, std::int64_t value)
+{
+    save_models(PATH, model);
+    std::vector<char> bytes = read_file(PATH);
+    auto* header = reinterpret_cast<ModelHeader*>(bytes.data());
+    auto* sections = reinterpret_cast<ModelSection*>(bytes.data()+header->sections_offset);
+    for (std::size_t s=0; s<header->n_sections; s++)
+    {
+        if (sections[s].field == ModelField::config)
+        {
+            reinterpret_cast<std::int64_t*>(bytes.data()+sections[s].offset)[k] = value;
+        }
+    }
+    write_file(PATH, bytes);
+    return throws_runtime_error([] { return MappedModels(PATH).load<Model>(); });
+}
+
+// Well formed files with config values that no model can have
+void test_damaged_configs(const Array2D<float>& X)
+{
+    LinearRegression lr({.solver=Solver::normal_equations});
+    lr.fit(X, std::vector<float>(X.size(), 1.f));
+    MLPP_CHECK(rejects_config(lr, 1, 0)); //n_jobs
+    MLPP_CHECK(rejects_config(lr, 1, std::int64_t{1} << 40));
+
+    std::vector<int> labels(X.size());
+    for (std::size_t i=0; i<X.size(); i++)
+    {
+        labels[i] = X[i][0] > 1.f;
+    }
+    LogisticRegression clf({.max_iter=5, .solver=Solver::lbfgs});
+    clf.fit(X, labels);
+    MLPP_CHECK(rejects_config(clf, 1, 7)); //multiclass
+    MLPP_CHECK(rejects_config(clf, 2, 0));
+
+    ZScoreNormalizer normalizer;
+    normalizer.fit(X);
+    MLPP_CHECK(rejects_config(normalizer, 0, 0)); //n_samples_seen
+    MLPP_CHECK(rejects_config(normalizer, 1, 0));
+
+    PolynomialFeatures poly(2);
+    poly.fit(X);
+    MLPP_CHECK(rejects_config(poly, 0, 3)); //min_degree above max_degree
+    MLPP_CHECK(rejects_config(poly, 2, 2)); //interaction_only
+    MLPP_CHECK(rejects_config(poly, 4, 0));
+    MLPP_CHECK(rejects_config(poly, 5, -1)); //n_features
+}
+}// namespace
+
+int main()
+{
+    Array2D<float> X = test::random_matrix(500, 4, 42, -3.f, 5.f);
+    test_linear_regression(X);
+    test_logistic_regression(X, 2, MultiClass::ovr);
+    test_logistic_regression(X, 3, MultiClass::ovr);
+    test_logistic_regression(X, 3, MultiClass::multinomial);
+    test_zscore_normalizer(X);
+    test_polynomial_features(X);
+    test_damaged_files(X);
+    test_damaged_configs(X);
+    std::filesystem::remove(PATH);
+    return test::exit_code();
+}
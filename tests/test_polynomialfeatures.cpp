@@ -0,0 +1,65 @@
+#include <polynomialfeatures.hpp>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include "check.hpp"
+
+// StaticPolynomialFeatures has to produce the same columns, in the same order and with the same bits, as the runtime
+// PolynomialFeatures for every combination of degrees, interaction_only and include_bias. Its row transform is
+// constexpr, so some expansions are checked at compile time as well.
+using namespace ML;
+
+namespace
+{
+constexpr std::size_t N_FEATURES = 3;
+
+//x = (2, 3, 5): bias, then degree 2 (x0^2, x0x1, x0x2, x1^2, x1x2, x2^2), then degree 3 starting with x0^3
+constexpr auto FULL = StaticPolynomialFeatures<N_FEATURES, 2, 3, false, true>::transform_row(std::array<float, N_FEATURES>{2, 3, 5});
+static_assert(FULL.size() == 1+6+10);
+static_assert(FULL[0] == 1 and FULL[1] == 4 and FULL[2] == 6 and FULL[6] == 25 and FULL[7] == 8 and FULL[16] == 125);
+
+//Products of distinct features only: x0, x1, x2, x0x1, x0x2, x1x2, x0x1x2
+constexpr auto INTERACTIONS = StaticPolynomialFeatures<N_FEATURES, 1, 3, true, false, double>::transform_row(std::array<double, N_FEATURES>{2, 3, 5});
+static_assert(INTERACTIONS == std::array<double, 7>{2, 3, 5, 6, 10, 15, 30});
+
+template <int MinDegree, int MaxDegree, bool InteractionOnly, bool IncludeBias>
+void check_same_output(Array2DView<const float> X)
+{
+    using Static = StaticPolynomialFeatures<N_FEATURES, MinDegree, MaxDegree, InteractionOnly, IncludeBias>;
+    PolynomialFeatures runtime(std::pair(MinDegree, MaxDegree), InteractionOnly, IncludeBias);
+    Array2D<float> expected = runtime.fit_transform(X);
+    Array2D<float> got = Static().fit_transform(X);
+    MLPP_CHECK(expected.shape().second == Static::n_features_out);
+    MLPP_CHECK(got.shape() == expected.shape());
+    for (std::size_t i=0; i<X.size() and got.shape() == expected.shape(); i++)
+    {
+        MLPP_CHECK(test::bitwise_equal<float>(got[i], expected[i]));
+    }
+}
+
+template <int MinDegree, int MaxDegree>
+void check_degrees(Array2DView<const float> X)
+{
+    check_same_output<MinDegree, MaxDegree, false, false>(X);
+    check_same_output<MinDegree, MaxDegree, false, true>(X);
+    check_same_output<MinDegree, MaxDegree, true, false>(X);
+    check_same_output<MinDegree, MaxDegree, true, true>(X);
+}
+}// namespace
+
+int main()
+{
+    Array2D<float> X = test::random_matrix(64, N_FEATURES, 3, -2.f, 2.f);
+    check_degrees<0, 1>(X);
+    check_degrees<0, 2>(X);
+    check_degrees<0, 3>(X);
+    check_degrees<1, 1>(X);
+    check_degrees<1, 2>(X);
+    check_degrees<1, 3>(X);
+    check_degrees<2, 2>(X);
+    check_degrees<2, 3>(X);
+    check_degrees<3, 3>(X);
+    check_degrees<3, 4>(X);
+    return test::exit_code();
+}